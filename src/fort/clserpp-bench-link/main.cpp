@@ -0,0 +1,353 @@
+#include <chrono>
+#include <ctime>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cpptrace/exceptions.hpp>
+#include <cpptrace/utils.hpp>
+
+#include <argparse/argparse.hpp>
+
+#include <spdlog/fmt/ranges.h>
+#include <spdlog/spdlog.h>
+
+#include <fort/clserpp/buffer.hpp>
+#include <fort/clserpp/buffered_io.hpp>
+#include <fort/clserpp/clserpp.hpp>
+#include <fort/clserpp/details.hpp>
+#include <fort/clserpp/exceptions.hpp>
+#include <fort/clserpp/negotiation.hpp>
+#include <fort/clserpp/statistics.hpp>
+
+using namespace fort::clserpp;
+
+struct Opts : public argparse::Args {
+	int &interface = kwarg("i,idx", "Interface to use").set_default(0);
+	std::string &termination =
+	    kwarg(
+	        "t,termination",
+	        "Line termination to use [allowed: <none,lf,cr,crlf,null>]"
+	    )
+	        .set_default("crlf");
+
+	std::string &delimiter =
+	    kwarg("d,delimiter", "reply delimiter, escaped").set_default("\\r\\n");
+
+	int &timeout =
+	    kwarg("T,timeout", "timeout for IO operation in ms").set_default(1000);
+
+	std::string &command =
+	    kwarg("c,command", "command of the ping-pong and burst workloads")
+	        .set_default("ping");
+
+	std::string &mixed =
+	    kwarg("m,mixed", "comma separated commands of the mixed workload")
+	        .set_default("id?,exp?,gain=2,exposure=1000,temperature?");
+
+	int &size =
+	    kwarg("s,size", "payload size of the echo workload").set_default(256);
+
+	int &rounds = kwarg("r,rounds", "commands per workload").set_default(100);
+
+	int &burst =
+	    kwarg("n,burst", "commands sent at once by the burst workload")
+	        .set_default(16);
+
+	int &window =
+	    kwarg("w,window", "commands sent ahead of their reply by the echo and "
+	                      "mixed workloads")
+	        .set_default(4);
+
+	std::string &switchCommand =
+	    kwarg(
+	        "S,switch",
+	        "camera command switching its baudrate before each step of the "
+	        "sweep, '{}' is replaced by the baudrate [i.e. 'baud={}']. Leave "
+	        "empty for a loopback"
+	    )
+	        .set_default("");
+
+	std::string &output =
+	    kwarg("o,output", "JSON report file, '-' for stdout").set_default("-");
+};
+
+struct WorkloadResult {
+	std::vector<double> roundTrips;
+	size_t              sent = 0, received = 0, failures = 0;
+	double              elapsed = 0.0;
+};
+
+// Sends commands, keeping up to window of them ahead of their replies. A
+// burst waits for all replies before sending the next window. On a read or
+// write timeout, the link is flushed and all pending commands are failed.
+WorkloadResult runWorkload(
+    Serial                         &serial,
+    ReadBuffer<Serial>             &buffer,
+    const std::vector<std::string> &commands,
+    size_t                          window,
+    bool                            burst,
+    const Opts                     &opts
+) {
+	using clock = std::chrono::steady_clock;
+
+	const auto termination =
+	    details::termination_cast(opts.termination).value();
+	const auto delimiter = details::parse_ascii(opts.delimiter);
+
+	WorkloadResult                res;
+	std::deque<clock::time_point> inflight;
+	size_t                        next  = 0;
+	const auto                    start = clock::now();
+
+	const auto abort = [&]() {
+		res.failures += inflight.size();
+		inflight.clear();
+		serial.Flush();
+		buffer.Clear();
+	};
+
+	while (next < commands.size() || inflight.empty() == false) {
+		if (burst == false || inflight.empty()) {
+			for (; next < commands.size() && inflight.size() < window; ++next) {
+				Buffer out{commands[next], termination};
+				try {
+					serial.Write(out, opts.timeout);
+				} catch (const IOTimeout &e) {
+					res.sent += e.bytes();
+					++res.failures;
+					abort();
+					continue;
+				}
+				res.sent += out.size();
+				inflight.push_back(clock::now());
+			}
+		}
+		if (inflight.empty()) {
+			continue;
+		}
+
+		try {
+			const auto reply = buffer.ReadUntilView(opts.timeout, delimiter);
+			const auto roundTrip = clock::now() - inflight.front();
+			res.roundTrips.push_back(
+			    std::chrono::duration<double, std::milli>(roundTrip).count()
+			);
+			res.received += reply.size();
+			inflight.pop_front();
+		} catch (const IOTimeout &) {
+			abort();
+		}
+	}
+	res.elapsed = std::chrono::duration<double>(clock::now() - start).count();
+	return res;
+}
+
+std::vector<std::string> splitCommands(const std::string &list) {
+	std::vector<std::string> res;
+	std::istringstream       iss{list};
+	for (std::string command; std::getline(iss, command, ',');) {
+		res.push_back(details::parse_ascii(command));
+	}
+	if (res.empty()) {
+		throw cpptrace::runtime_error("mixed workload has no command");
+	}
+	return res;
+}
+
+std::string echoPayload(size_t size, const std::string &delimiter) {
+	std::mt19937                       rng(size);
+	std::uniform_int_distribution<int> printable{0x21, 0x7e};
+	std::string                        res;
+	while (res.size() < size) {
+		const char c = printable(rng);
+		if (delimiter.find(c) == std::string::npos) {
+			res.push_back(c);
+		}
+	}
+	return res;
+}
+
+std::string jsonString(const std::string &value) {
+	std::string res = "\"";
+	for (const char c : value) {
+		if (c == '"' || c == '\\') {
+			res.push_back('\\');
+			res.push_back(c);
+		} else if (uint8_t(c) < 0x20) {
+			res += fmt::format("\\u{:04x}", int(c));
+		} else {
+			res.push_back(c);
+		}
+	}
+	return res + "\"";
+}
+
+std::string jsonWorkload(const std::string &name, const WorkloadResult &r) {
+	const auto rtt = Summarize(r.roundTrips);
+	return fmt::format(
+	    "{{\"workload\": {}, \"commands\": {}, \"failures\": {}, "
+	    "\"elapsed_s\": {:.6f}, \"bytes_sent\": {}, \"bytes_received\": {}, "
+	    "\"sent_bytes_per_second\": {:.1f}, "
+	    "\"received_bytes_per_second\": {:.1f}, \"round_trip_ms\": "
+	    "{{\"min\": {:.4f}, \"mean\": {:.4f}, \"median\": {:.4f}, "
+	    "\"p99\": {:.4f}, \"max\": {:.4f}}}}}",
+	    jsonString(name),
+	    r.roundTrips.size() + r.failures,
+	    r.failures,
+	    r.elapsed,
+	    r.sent,
+	    r.received,
+	    r.elapsed > 0.0 ? r.sent / r.elapsed : 0.0,
+	    r.elapsed > 0.0 ? r.received / r.elapsed : 0.0,
+	    rtt.min,
+	    rtt.mean,
+	    rtt.median,
+	    rtt.p99,
+	    rtt.max
+	);
+}
+
+// returns false if the switch command could not be sent, the step is still
+// measured, its commands most likely fail.
+bool switchBaudrate(
+    Serial             &serial,
+    ReadBuffer<Serial> &buffer,
+    clBaudrate_e        baudrate,
+    const Opts         &opts
+) {
+	bool res = true;
+	if (opts.switchCommand.empty() == false) {
+		const auto command = details::format_switch_command(
+		    details::parse_ascii(opts.switchCommand),
+		    baudrate
+		);
+		const auto termination =
+		    details::termination_cast(opts.termination).value();
+		try {
+			serial.Write(Buffer{command, termination}, opts.timeout);
+		} catch (const IOTimeout &e) {
+			std::cerr << "could not switch to "
+			          << details::baudrate_value(baudrate) << ": "
+			          << e.what() << std::endl;
+			res = false;
+		}
+		// the camera may reply at either baudrate.
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	}
+	serial.SetBaudrate(baudrate);
+	serial.Flush();
+	buffer.Clear();
+	return res;
+}
+
+std::string utcTimestamp() {
+	const auto now = std::time(nullptr);
+	char       res[32];
+	std::strftime(res, sizeof(res), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+	return res;
+}
+
+int execute(int argc, char **argv) {
+	spdlog::set_level(spdlog::level::warn);
+	auto opts = argparse::parse<Opts>(argc, argv);
+	if (opts.rounds <= 0 || opts.burst <= 0 || opts.window <= 0 ||
+	    opts.size <= 0) {
+		throw cpptrace::runtime_error(
+		    "rounds, burst, window and size must be positive"
+		);
+	}
+
+	const auto descriptions = Serial::GetDescriptions();
+	if (opts.interface < 0 || size_t(opts.interface) >= descriptions.size()) {
+		throw cpptrace::runtime_error(
+		    "no interface " + std::to_string(opts.interface)
+		);
+	}
+	auto serial = std::shared_ptr<Serial>{Serial::Open(opts.interface)};
+	auto buffer = ReadBuffer<Serial>{serial};
+
+	const auto delimiter = details::parse_ascii(opts.delimiter);
+	const auto command   = details::parse_ascii(opts.command);
+	const auto payload   = echoPayload(opts.size, delimiter);
+	const auto mixed     = splitCommands(opts.mixed);
+
+	std::vector<std::string> steps;
+	for (const auto baudrate : serial->SupportedBaudrates()) {
+		const bool switched = switchBaudrate(*serial, buffer, baudrate, opts);
+
+		const auto run = [&](const std::string &name,
+		                     const std::vector<std::string> &commands,
+		                     size_t window,
+		                     bool burst) {
+			const auto res =
+			    runWorkload(*serial, buffer, commands, window, burst, opts);
+			std::cerr << details::baudrate_value(baudrate) << " " << name
+			          << ": " << res.roundTrips.size() << "/"
+			          << commands.size() << " replies, median "
+			          << Summarize(res.roundTrips).median << " ms"
+			          << std::endl;
+			return jsonWorkload(name, res);
+		};
+
+		std::vector<std::string> mixedCommands;
+		for (int i = 0; i < opts.rounds; ++i) {
+			mixedCommands.push_back(mixed[i % mixed.size()]);
+		}
+		const std::vector<std::string> commands(opts.rounds, command);
+
+		const std::string workloads[] = {
+		    run("ping-pong", commands, 1, false),
+		    run("echo",
+		        std::vector<std::string>(opts.rounds, payload),
+		        opts.window,
+		        false),
+		    run("burst", commands, opts.burst, true),
+		    run("mixed", mixedCommands, opts.window, false),
+		};
+		steps.push_back(fmt::format(
+		    "{{\"baudrate\": {}, \"switched\": {}, \"workloads\": [{}]}}",
+		    details::baudrate_value(baudrate),
+		    switched,
+		    fmt::join(workloads, ", ")
+		));
+	}
+
+	const auto report = fmt::format(
+	    "{{\"tool\": \"clserpp-bench-link\", \"timestamp\": {}, "
+	    "\"interface\": {}, \"port\": {}, \"manufacturer\": {}, "
+	    "\"command\": {}, \"payload_size\": {}, \"rounds\": {}, "
+	    "\"burst\": {}, \"window\": {}, \"steps\": [{}]}}\n",
+	    jsonString(utcTimestamp()),
+	    opts.interface,
+	    jsonString(descriptions[opts.interface].info),
+	    jsonString(Serial::GetManufacturerInfos().name),
+	    jsonString(command),
+	    opts.size,
+	    opts.rounds,
+	    opts.burst,
+	    opts.window,
+	    fmt::join(steps, ", ")
+	);
+
+	if (opts.output == "-") {
+		std::cout << report;
+	} else {
+		std::ofstream file{opts.output};
+		if (file.is_open() == false) {
+			throw cpptrace::runtime_error("could not open " + opts.output);
+		}
+		file << report;
+	}
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	cpptrace::register_terminate_handler();
+	return execute(argc, argv);
+}
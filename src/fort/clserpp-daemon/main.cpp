@@ -0,0 +1,79 @@
+#include <csignal>
+#include <thread>
+
+#include <cpptrace/exceptions.hpp>
+#include <cpptrace/utils.hpp>
+
+#include <argparse/argparse.hpp>
+
+#ifndef NDEBUG
+#define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_DEBUG
+#else
+#define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_INFO
+#endif
+
+#include <spdlog/spdlog.h>
+
+#include <fort/clserpp/clserpp.hpp>
+#include <fort/clserpp/daemon.hpp>
+
+using namespace fort::clserpp;
+
+struct Opts : public argparse::Args {
+	std::string &socket =
+	    kwarg("s,socket", "unix socket to listen on")
+	        .set_default(details::default_daemon_socket());
+
+	int &ring = kwarg("r,ring", "per client receive ring size in KiB")
+	                .set_default(1024);
+
+	int &poll = kwarg("p,poll", "port polling period in ms").set_default(20);
+
+	int &timeout =
+	    kwarg("T,timeout", "timeout for write operations in ms")
+	        .set_default(1000);
+};
+
+void execute(int argc, char **argv) {
+	auto opts = argparse::parse<Opts>(argc, argv);
+
+	DaemonOptions dopts;
+	dopts.socket          = opts.socket;
+	dopts.ringCapacity    = size_t(opts.ring) * 1024;
+	dopts.pollTimeout_ms  = opts.poll;
+	dopts.writeTimeout_ms = opts.timeout;
+
+	// signals are handled by a dedicated thread, all others inherit the mask.
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+	DaemonServer<Serial> server{
+	    [](uint32_t index) {
+		    return std::shared_ptr<Serial>{Serial::Open(index)};
+	    },
+	    []() { return Serial::GetDescriptions(); },
+	    dopts,
+	};
+
+	std::thread waiter{[&signals, &server]() {
+		int received = 0;
+		sigwait(&signals, &received);
+		SPDLOG_INFO("received signal {}, stopping", received);
+		server.Stop();
+	}};
+
+	server.Run();
+	// unblocks the waiter if Run() terminated by itself.
+	pthread_kill(waiter.native_handle(), SIGTERM);
+	waiter.join();
+}
+
+int main(int argc, char **argv) {
+	cpptrace::register_terminate_handler();
+	spdlog::set_level(spdlog::level::info);
+	execute(argc, argv);
+	return 0;
+}
@@ -1,7 +1,13 @@
 #include "fort/clserpp/exceptions.hpp"
+#include <charconv>
+#include <chrono>
+#include <deque>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <iterator>
+#include <optional>
+#include <regex>
 #include <sstream>
 #include <string>
 
@@ -23,6 +29,8 @@
 #include "fort/clserpp/details.hpp"
 #include <fort/clserpp/buffer.hpp>
 #include <fort/clserpp/clserpp.hpp>
+#include <fort/clserpp/negotiation.hpp>
+#include <fort/clserpp/statistics.hpp>
 
 using namespace fort::clserpp;
 
@@ -43,6 +51,39 @@ struct Opts : public argparse::Args {
 
 	int &timeout =
 	    kwarg("T,timeout", "timeout for IO operation in ms").set_default(1000);
+
+	std::string &negotiate =
+	    kwarg(
+	        "N,negotiate",
+	        "camera command switching baudrate, used to negotiate the fastest "
+	        "verified baudrate, '{}' is replaced by the baudrate [i.e. "
+	        "'baud={}']"
+	    )
+	        .set_default("");
+
+	std::string &identify =
+	    kwarg("I,identify", "command used to verify the link when negotiating")
+	        .set_default("");
+
+	std::string &identifyReply =
+	    kwarg(
+	        "R,identify-reply",
+	        "text the reply to the identify command must contain, escaped"
+	    )
+	        .set_default("");
+
+	std::string &batch =
+	    kwarg(
+	        "B,batch",
+	        "command script to run instead of the prompt, '-' reads stdin. "
+	        "Each line is '<command>[<TAB><reply regex>[<TAB><timeout ms>]]', "
+	        "commands are unescaped, and '#' starts a comment line"
+	    )
+	        .set_default("");
+
+	int &window =
+	    kwarg("w,window", "commands sent ahead of their reply in batch mode")
+	        .set_default(8);
 };
 
 std::unique_ptr<Serial> openInterface(int interface) {
@@ -75,7 +116,7 @@ std::string enumerateBaudrates(const std::vector<clBaudrate_e> &baudrates) {
 	return oss.str();
 }
 
-void setupBaudrate(Serial &serial, int baudrate) {
+clBaudrate_e setupBaudrate(Serial &serial, int baudrate) {
 	auto e = details::baudrate_cast("CL_BAUDRATE_" + std::to_string(baudrate));
 
 	const auto supported = serial.SupportedBaudrates();
@@ -90,9 +131,207 @@ void setupBaudrate(Serial &serial, int baudrate) {
 	}
 
 	serial.SetBaudrate(e.value());
+	return e.value();
+}
+
+void negotiateBaudrate(
+    Serial             &serial,
+    ReadBuffer<Serial> &buffer,
+    clBaudrate_e        current,
+    const Opts         &opts
+) {
+	if (opts.identify.empty() || opts.identifyReply.empty()) {
+		throw cpptrace::runtime_error(
+		    "an identify command and its expected reply are required to "
+		    "negotiate the baudrate"
+		);
+	}
+	NegotiationOptions nopts;
+	nopts.switchCommand   = details::parse_ascii(opts.negotiate);
+	nopts.identifyCommand = details::parse_ascii(opts.identify);
+	nopts.identifyReply   = details::parse_ascii(opts.identifyReply);
+	nopts.termination = details::termination_cast(opts.termination).value();
+	nopts.delimiter   = opts.delimiter;
+	nopts.timeout_ms  = opts.timeout;
+
+	const auto res = NegotiateBaudrate(serial, buffer, current, nopts);
+	for (const auto &probe : res.probes) {
+		std::cout << std::setw(7) << details::baudrate_value(probe.baudrate)
+		          << ": " << probe.rounds - probe.failures << "/"
+		          << probe.rounds << " round trips, " << std::fixed
+		          << std::setprecision(1) << probe.bytesPerSecond << " B/s"
+		          << std::endl;
+	}
+	std::cout << "negotiated baudrate: "
+	          << details::baudrate_value(res.baudrate) << std::endl;
 }
 
-void execute(int argc, char **argv) {
+struct BatchCommand {
+	size_t                    line;
+	std::string               command;
+	std::string               pattern;
+	std::optional<std::regex> expected;
+	uint32_t                  timeout_ms;
+};
+
+// Throws a cpptrace::invalid_argument naming the script line if its reply
+// pattern or its timeout is invalid.
+std::optional<BatchCommand>
+parseBatchLine(const std::string &text, size_t line, uint32_t timeout_ms) {
+	if (text.empty() || text[0] == '#') {
+		return std::nullopt;
+	}
+	std::vector<std::string> fields;
+	std::istringstream       iss{text};
+	for (std::string field; std::getline(iss, field, '\t');) {
+		fields.push_back(field);
+	}
+
+	const auto invalid = [line](const std::string &what) {
+		return cpptrace::invalid_argument(
+		    "line " + std::to_string(line) + ": " + what
+		);
+	};
+
+	BatchCommand res{
+	    .line       = line,
+	    .command    = details::parse_ascii(fields[0]),
+	    .pattern    = {},
+	    .expected   = std::nullopt,
+	    .timeout_ms = timeout_ms,
+	};
+	if (fields.size() > 1 && fields[1].empty() == false) {
+		res.pattern = fields[1];
+		try {
+			res.expected = std::regex{fields[1]};
+		} catch (const std::regex_error &e) {
+			throw invalid(
+			    "invalid reply pattern '" + fields[1] + "': " + e.what()
+			);
+		}
+	}
+	if (fields.size() > 2 && fields[2].empty() == false) {
+		const auto &field = fields[2];
+		const auto  last  = field.data() + field.size();
+		const auto [ptr, ec] =
+		    std::from_chars(field.data(), last, res.timeout_ms);
+		if (ec != std::errc{} || ptr != last) {
+			throw invalid("invalid timeout '" + field + "'");
+		}
+	}
+	return res;
+}
+
+// Sends the commands of a script, keeping up to opts.window commands ahead
+// of their replies. Invalid script lines are reported and skipped. On a
+// timeout, the link is flushed and all pending commands fail, so a late
+// reply is never matched to the next command. Returns the number of failed
+// commands, including the invalid lines.
+size_t runBatch(
+    Serial             &serial,
+    ReadBuffer<Serial> &buffer,
+    LineTermination     termination,
+    const Opts         &opts
+) {
+	using clock = std::chrono::steady_clock;
+	struct Inflight {
+		BatchCommand      command;
+		clock::time_point sent;
+	};
+
+	std::ifstream file;
+	if (opts.batch != "-") {
+		file.open(opts.batch);
+		if (file.is_open() == false) {
+			throw cpptrace::runtime_error("could not open " + opts.batch);
+		}
+	}
+	std::istream &in = opts.batch == "-" ? std::cin : file;
+
+	const size_t         window = std::max(opts.window, 1);
+	std::deque<Inflight> inflight;
+	std::vector<double>  roundTrips;
+	size_t               failures = 0, sent = 0, received = 0, line = 0;
+	const auto           start = clock::now();
+	std::string          text;
+
+	while (true) {
+		while (inflight.size() < window && std::getline(in, text)) {
+			std::optional<BatchCommand> command;
+			try {
+				command = parseBatchLine(text, ++line, opts.timeout);
+			} catch (const cpptrace::invalid_argument &e) {
+				++failures;
+				std::cout << e.message() << std::endl;
+				continue;
+			}
+			if (command.has_value() == false) {
+				continue;
+			}
+			Buffer out{command->command, termination};
+			serial.Write(out, command->timeout_ms);
+			sent += out.size();
+			inflight.push_back({std::move(command.value()), clock::now()});
+		}
+		if (inflight.empty()) {
+			break;
+		}
+
+		const auto current = std::move(inflight.front());
+		inflight.pop_front();
+		std::string reply;
+		try {
+			reply =
+			    buffer.ReadUntil(current.command.timeout_ms, opts.delimiter);
+		} catch (const IOTimeout &) {
+			std::cout << "line " << current.command.line << ": '"
+			          << details::escape(current.command.command)
+			          << "' timed out" << std::endl;
+			for (const auto &pending : inflight) {
+				std::cout << "line " << pending.command.line << ": '"
+				          << details::escape(pending.command.command)
+				          << "' aborted" << std::endl;
+			}
+			failures += 1 + inflight.size();
+			inflight.clear();
+			serial.Flush();
+			buffer.Clear();
+			continue;
+		}
+		const auto roundTrip = clock::now() - current.sent;
+		roundTrips.push_back(
+		    std::chrono::duration<double, std::milli>(roundTrip).count()
+		);
+		received += reply.size();
+		reply.resize(reply.size() - opts.delimiter.size());
+		std::cout << "<<< " << reply << std::endl;
+
+		const auto &expected = current.command.expected;
+		if (expected.has_value() &&
+		    std::regex_search(reply, expected.value()) == false) {
+			++failures;
+			std::cout << "line " << current.command.line << ": reply '"
+			          << details::escape(reply) << "' does not match '"
+			          << current.command.pattern << "'" << std::endl;
+		}
+	}
+
+	const double elapsed =
+	    std::chrono::duration<double>(clock::now() - start).count();
+	const auto rtt = Summarize(roundTrips);
+	std::cout << std::fixed << std::setprecision(3) << "batch: " << line
+	          << " lines, " << roundTrips.size() << " replies, " << failures
+	          << " failures in " << elapsed << " s" << std::endl
+	          << "round trip (ms): min " << rtt.min << ", median "
+	          << rtt.median << ", p99 " << rtt.p99 << ", max " << rtt.max
+	          << std::endl
+	          << std::setprecision(1) << "throughput: sent " << sent << " B ("
+	          << sent / elapsed << " B/s), received " << received << " B ("
+	          << received / elapsed << " B/s)" << std::endl;
+	return failures;
+}
+
+int execute(int argc, char **argv) {
 #ifndef NDEBUG
 	auto fileLogger = spdlog::basic_logger_mt("file", "logs.txt");
 	spdlog::set_default_logger(fileLogger);
@@ -107,13 +346,21 @@ void execute(int argc, char **argv) {
 
 	auto serial =
 	    std::shared_ptr<Serial>(std::move(openInterface(opts.interface)));
-	setupBaudrate(*serial, opts.baudrate);
+	const auto baudrate = setupBaudrate(*serial, opts.baudrate);
 
 	auto buffer      = ReadBuffer<Serial>{serial};
 	auto termination = details::termination_cast(opts.termination).value();
 
+	if (opts.negotiate.empty() == false) {
+		negotiateBaudrate(*serial, buffer, baudrate, opts);
+	}
+
 	SPDLOG_INFO("using delimiter {}", details::escape(opts.delimiter));
 
+	if (opts.batch.empty() == false) {
+		return runBatch(*serial, buffer, termination, opts) == 0 ? 0 : 1;
+	}
+
 	std::string line;
 
 	while (true) {
@@ -122,11 +369,10 @@ void execute(int argc, char **argv) {
 		    buffer.BytesAvailable(),
 		    serial->BytesAvailable()
 		);
-		while (buffer.BytesAvailable() > 0 || serial->BytesAvailable() > 0) {
-
-			std::cout << buffer.ReadUntil(opts.timeout, opts.delimiter)
-			          << std::flush;
+		for (auto pending : buffer.Lines(opts.timeout, opts.delimiter)) {
+			std::cout << pending;
 		}
+		std::cout << std::flush;
 
 		line.clear();
 		std::cout << ">>> " << std::flush;
@@ -150,10 +396,10 @@ void execute(int argc, char **argv) {
 			throw;
 		}
 	}
+	return 0;
 }
 
 int main(int argc, char **argv) {
 	cpptrace::register_terminate_handler();
-	execute(argc, argv);
-	return 0;
+	return execute(argc, argv);
 }
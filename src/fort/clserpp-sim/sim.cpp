@@ -0,0 +1,208 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+// Simulated clser implementation: each port is a loopback, bytes written
+// are read back. The number of ports is set by CLSERPP_SIM_PORTS (default
+// 2).
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <fort/clserpp/clser.h>
+
+namespace {
+
+enum Error : int32_t {
+	BUFFER_TOO_SMALL        = -10001,
+	PORT_IN_USE             = -10003,
+	TIMEOUT                 = -10004,
+	INVALID_INDEX           = -10005,
+	INVALID_REFERENCE       = -10006,
+	ERROR_NOT_FOUND         = -10007,
+	BAUD_RATE_NOT_SUPPORTED = -10008,
+};
+
+struct Port {
+	std::mutex              mutex;
+	std::condition_variable available;
+	std::deque<char>        pending;
+	bool                    opened   = false;
+	uint32_t                baudrate = CL_BAUDRATE_9600;
+};
+
+std::vector<Port> &ports() {
+	static std::vector<Port> ports([] {
+		const char *env = std::getenv("CLSERPP_SIM_PORTS");
+		return env != nullptr ? std::strtoul(env, nullptr, 10) : 2;
+	}());
+	return ports;
+}
+
+Port *port(clSerialRef_t serial) {
+	auto &all = ports();
+	for (auto &p : all) {
+		if (&p == serial) {
+			return &p;
+		}
+	}
+	return nullptr;
+}
+
+int32_t copyText(const char *text, char *buffer, uint32_t *size) {
+	const uint32_t needed = std::strlen(text) + 1;
+	if (*size < needed) {
+		*size = needed;
+		return BUFFER_TOO_SMALL;
+	}
+	std::memcpy(buffer, text, needed);
+	*size = needed;
+	return 0;
+}
+
+} // namespace
+
+int32_t clSerialInit(uint32_t index, clSerialRef_t *ref) {
+	auto &all = ports();
+	if (index >= all.size()) {
+		return INVALID_INDEX;
+	}
+	std::lock_guard<std::mutex> lock{all[index].mutex};
+	if (all[index].opened) {
+		return PORT_IN_USE;
+	}
+	all[index].opened = true;
+	all[index].pending.clear();
+	*ref = &all[index];
+	return 0;
+}
+
+void clSerialClose(clSerialRef_t serial) {
+	if (auto p = port(serial)) {
+		std::lock_guard<std::mutex> lock{p->mutex};
+		p->opened = false;
+	}
+}
+
+int32_t clSerialRead(
+    clSerialRef_t serial, char *buffer, uint32_t *size, uint32_t timeout_ms
+) {
+	auto p = port(serial);
+	if (p == nullptr) {
+		return INVALID_REFERENCE;
+	}
+	std::unique_lock<std::mutex> lock{p->mutex};
+	if (p->available.wait_for(
+	        lock,
+	        std::chrono::milliseconds(timeout_ms),
+	        [p] { return p->pending.empty() == false; }
+	    ) == false) {
+		*size = 0;
+		return TIMEOUT;
+	}
+	*size = std::min(*size, uint32_t(p->pending.size()));
+	std::copy_n(p->pending.begin(), *size, buffer);
+	p->pending.erase(p->pending.begin(), p->pending.begin() + *size);
+	return 0;
+}
+
+int32_t clSerialWrite(
+    clSerialRef_t serial,
+    const char   *buffer,
+    uint32_t     *size,
+    uint32_t      timeout_ms
+) {
+	auto p = port(serial);
+	if (p == nullptr) {
+		return INVALID_REFERENCE;
+	}
+	{
+		std::lock_guard<std::mutex> lock{p->mutex};
+		p->pending.insert(p->pending.end(), buffer, buffer + *size);
+	}
+	p->available.notify_all();
+	return 0;
+}
+
+int32_t clFlushPort(clSerialRef_t serial) {
+	auto p = port(serial);
+	if (p == nullptr) {
+		return INVALID_REFERENCE;
+	}
+	std::lock_guard<std::mutex> lock{p->mutex};
+	p->pending.clear();
+	return 0;
+}
+
+int32_t clGetErrorText(int32_t errorCode, char *buffer, uint32_t *size) {
+	switch (errorCode) {
+	case BUFFER_TOO_SMALL:
+		return copyText("buffer too small", buffer, size);
+	case PORT_IN_USE:
+		return copyText("port in use", buffer, size);
+	case TIMEOUT:
+		return copyText("timeout", buffer, size);
+	case INVALID_INDEX:
+		return copyText("invalid index", buffer, size);
+	case INVALID_REFERENCE:
+		return copyText("invalid reference", buffer, size);
+	case BAUD_RATE_NOT_SUPPORTED:
+		return copyText("baudrate not supported", buffer, size);
+	default:
+		return ERROR_NOT_FOUND;
+	}
+}
+
+int32_t clGetManufacturerInfo(char *buffer, uint32_t *size, uint32_t *version) {
+	*version = CL_VERSION_1_1;
+	return copyText("clserpp-sim", buffer, size);
+}
+
+int32_t clGetNumBytesAvail(clSerialRef_t serial, uint32_t *numBytes) {
+	auto p = port(serial);
+	if (p == nullptr) {
+		return INVALID_REFERENCE;
+	}
+	std::lock_guard<std::mutex> lock{p->mutex};
+	*numBytes = p->pending.size();
+	return 0;
+}
+
+int32_t clGetNumSerialPorts(uint32_t *serialPorts) {
+	*serialPorts = ports().size();
+	return 0;
+}
+
+int32_t clGetSerialPortIdentifier(uint32_t idx, char *buffer, uint32_t *size) {
+	if (idx >= ports().size()) {
+		return INVALID_INDEX;
+	}
+	const std::string id = "clserpp-sim loopback " + std::to_string(idx);
+	return copyText(id.c_str(), buffer, size);
+}
+
+int32_t clGetSupportedBaudRates(clSerialRef_t serial, uint32_t *baudrates) {
+	if (port(serial) == nullptr) {
+		return INVALID_REFERENCE;
+	}
+	*baudrates = 0xff;
+	return 0;
+}
+
+int32_t clSetBaudRate(clSerialRef_t serial, uint32_t baudrate) {
+	auto p = port(serial);
+	if (p == nullptr) {
+		return INVALID_REFERENCE;
+	}
+	if (baudrate == 0 || baudrate > 0xff || (baudrate & (baudrate - 1))) {
+		return BAUD_RATE_NOT_SUPPORTED;
+	}
+	std::lock_guard<std::mutex> lock{p->mutex};
+	p->baudrate = baudrate;
+	return 0;
+}
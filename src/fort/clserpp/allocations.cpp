@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+
+#include "buffer.hpp"
+#include "buffered_io.hpp"
+#include "exceptions.hpp"
+#include "reply.hpp"
+
+// Counts the allocations of the calling thread. The global operator new is
+// replaced for the whole program, so these tests are built as their own
+// executable, clserpp-allocation-tests.
+static thread_local size_t allocations = 0;
+
+void *operator new(size_t size) {
+	++allocations;
+	if (void *ptr = std::malloc(size == 0 ? 1 : size)) {
+		return ptr;
+	}
+	throw std::bad_alloc{};
+}
+
+void operator delete(void *ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+	std::free(ptr);
+}
+
+using namespace fort::clserpp;
+
+// A camera echoing each command, followed by a reply and the prompt. Once
+// constructed, it never allocates.
+class AllocationCamera {
+public:
+	template <typename Container>
+	void Write(const Container &buf, uint32_t timeout_ms) {
+		for (size_t i = 0; i < buf.size(); ++i) {
+			push(buf[i]);
+		}
+		for (const char c : std::string_view{"value=42\r\n>"}) {
+			push(c);
+		}
+	}
+
+	template <typename Container>
+	void Read(Container &buf, uint32_t timeout_ms) {
+		size_t read = 0;
+		for (; read < buf.size() && d_head != d_tail; ++read) {
+			buf[read] = d_data[d_head++ % d_data.size()];
+		}
+		if (read < buf.size()) {
+			throw IOTimeout(read);
+		}
+	}
+
+	uint32_t BytesAvailable() const {
+		return d_tail - d_head;
+	}
+
+	void Flush() {
+		d_head = d_tail;
+	}
+
+private:
+	void push(char c) {
+		d_data[d_tail++ % d_data.size()] = c;
+	}
+
+	std::array<char, 1024> d_data;
+	size_t                 d_head = 0, d_tail = 0;
+};
+
+TEST(Allocations, CommandRoundTripsDoNotAllocate) {
+	auto       camera = std::make_shared<AllocationCamera>();
+	auto       buffer = ReadBuffer<AllocationCamera>{camera};
+	const auto prompt = std::string{"\r\n>"};
+
+	const std::string commands[] = {"exp?", "exposure=1000", "gain=2", "id?"};
+	const auto        roundTrip  = [&](const std::string &command) {
+		const Buffer out{command, LineTermination::CRLF};
+		camera->Write(out, 100);
+		const auto raw = buffer.ReadUntilView(100, prompt);
+		return Reply::Parse(raw, command).Number<int>("value").value_or(0);
+	};
+
+	// warms the pools up, the read buffer stamps span several blocks.
+	int sum = 0;
+	for (size_t i = 0; i < 100; ++i) {
+		sum += roundTrip(commands[i % 4]);
+	}
+
+	const size_t before = allocations;
+	for (size_t i = 0; i < 1000; ++i) {
+		sum += roundTrip(commands[i % 4]);
+	}
+	EXPECT_EQ(allocations - before, 0);
+	EXPECT_EQ(sum, 1100 * 42);
+}
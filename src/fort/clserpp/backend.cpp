@@ -0,0 +1,151 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+
+#include <unistd.h>
+
+#include "clserpp.hpp"
+
+using namespace fort::clserpp;
+
+#ifdef CLSERPP_SIM_BACKEND
+
+class BackendTest : public ::testing::Test {
+protected:
+	void SetUp() override {
+		SetBackends({CLSERPP_SIM_BACKEND});
+	}
+
+	void TearDown() override {
+		SetBackends({});
+	}
+};
+
+TEST_F(BackendTest, LoadsAtRuntime) {
+	EXPECT_EQ(GetBackends(), std::vector<std::string>{CLSERPP_SIM_BACKEND});
+	EXPECT_EQ(Serial::GetManufacturerInfos().name, "clserpp-sim");
+	EXPECT_EQ(Serial::NumSerial(), 2);
+
+	auto        serial = Serial::Open(1);
+	std::string message{"hello"}, reply(5, 0);
+	serial->Write(message, 100);
+	EXPECT_EQ(serial->BytesAvailable(), 5);
+	serial->Read(reply, 100);
+	EXPECT_EQ(reply, message);
+	EXPECT_THROW({ serial->Read(reply, 1); }, IOTimeout);
+}
+
+TEST_F(BackendTest, AggregatesPorts) {
+	// a copy is loaded as a distinct library, with its own ports.
+	const auto copy = std::filesystem::temp_directory_path() /
+	                  ("clserpp-sim-" + std::to_string(::getpid()) + ".so");
+	std::filesystem::copy_file(
+	    CLSERPP_SIM_BACKEND,
+	    copy,
+	    std::filesystem::copy_options::overwrite_existing
+	);
+	SetBackends({CLSERPP_SIM_BACKEND, copy.string()});
+	std::filesystem::remove(copy);
+	EXPECT_EQ(Serial::NumSerial(), 4);
+
+	const auto descriptions = Serial::GetDescriptions();
+	ASSERT_EQ(descriptions.size(), 4);
+	for (uint32_t i = 0; i < descriptions.size(); ++i) {
+		EXPECT_EQ(descriptions[i].index, i);
+		EXPECT_EQ(
+		    descriptions[i].info,
+		    "clserpp-sim loopback " + std::to_string(i % 2)
+		);
+	}
+	// the third port is the first one of the second backend.
+	auto first  = Serial::Open(0);
+	auto second = Serial::Open(2);
+	EXPECT_THROW({ Serial::Open(0); }, details::clserException);
+	EXPECT_THROW({ Serial::Open(4); }, cpptrace::out_of_range);
+
+	std::string message{"first"}, reply(5, 0);
+	first->Write(message, 100);
+	EXPECT_EQ(second->BytesAvailable(), 0);
+	first->Read(reply, 100);
+	EXPECT_EQ(reply, message);
+}
+
+TEST_F(BackendTest, IgnoresRepeatedBackends) {
+	SetBackends({CLSERPP_SIM_BACKEND, CLSERPP_SIM_BACKEND});
+	EXPECT_EQ(GetBackends(), std::vector<std::string>{CLSERPP_SIM_BACKEND});
+	EXPECT_EQ(Serial::NumSerial(), 2);
+}
+
+TEST_F(BackendTest, ReportsBackendErrors) {
+	auto serial = Serial::Open(0);
+	try {
+		serial->SetBaudrate(clBaudrate_e(3));
+		ADD_FAILURE() << "should have thrown";
+	} catch (const details::clserException &e) {
+		EXPECT_EQ(e.code(), -10008);
+		EXPECT_STREQ(e.what(), "clser error (-10008): baudrate not supported");
+	}
+}
+
+// a reader, a writer and a third thread changing the baudrate share a
+// loopback port.
+TEST_F(BackendTest, SerialIsFullDuplex) {
+	auto              serial = Serial::Open(0);
+	const uint64_t    count  = 2000;
+	std::atomic<bool> done{false};
+
+	std::thread writer([&]() {
+		for (uint64_t i = 0; i < count; ++i) {
+			std::string record(sizeof(i), 0);
+			std::memcpy(record.data(), &i, sizeof(i));
+			serial->Write(record, 100);
+		}
+	});
+
+	std::thread switcher([&]() {
+		const auto &baudrates  = serial->SupportedBaudrates();
+		uint64_t    generation = serial->Generation();
+		for (size_t i = 0; done.load() == false; ++i) {
+			serial->SetBaudrate(baudrates[i % baudrates.size()]);
+			EXPECT_GT(serial->Generation(), generation);
+			generation = serial->Generation();
+		}
+	});
+
+	size_t mismatches = 0;
+	try {
+		for (uint64_t i = 0; i < count; ++i) {
+			std::string record(sizeof(i), 0);
+			uint64_t    value = 0;
+			serial->Read(record, 1000);
+			std::memcpy(&value, record.data(), sizeof(value));
+			mismatches += value != i;
+		}
+	} catch (const IOTimeout &e) {
+		ADD_FAILURE() << "reader " << e.what();
+	}
+	done.store(true);
+	writer.join();
+	switcher.join();
+
+	EXPECT_EQ(mismatches, 0);
+	EXPECT_EQ(serial->BytesAvailable(), 0);
+
+	const Serial &port       = *serial;
+	const auto    generation = port.Generation();
+	port.Flush();
+	EXPECT_NE(port.Generation(), generation);
+}
+
+#endif
+
+TEST(Backend, ReportsLoadingErrors) {
+	EXPECT_THROW(
+	    { SetBackends({"/nonexistent/libclser.so"}); },
+	    cpptrace::runtime_error
+	);
+	SetBackends({});
+}
@@ -0,0 +1,266 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <dlfcn.h>
+
+#include <cpptrace/exceptions.hpp>
+
+#include "clser.h"
+
+// With CLSERPP_DYNAMIC_BACKEND, the clser library is not linked, and is
+// only loaded when a port is first used.
+#ifndef CLSERPP_DYNAMIC_BACKEND
+#define CLSERPP_DYNAMIC_BACKEND 0
+#endif
+
+#ifndef CLSERPP_DEFAULT_BACKEND
+#define CLSERPP_DEFAULT_BACKEND "libclsermv.so"
+#endif
+
+namespace fort {
+namespace clserpp {
+namespace details {
+
+// Function table of a clser implementation. Backends are never unloaded,
+// so they can be referred to by pointer for the whole process.
+struct Backend {
+	std::string name;
+
+	decltype(&clSerialInit)              SerialInit;
+	decltype(&clSerialClose)             SerialClose;
+	decltype(&clSerialRead)              SerialRead;
+	decltype(&clSerialWrite)             SerialWrite;
+	decltype(&clFlushPort)               FlushPort;
+	decltype(&clGetErrorText)            GetErrorText;
+	decltype(&clGetManufacturerInfo)     GetManufacturerInfo;
+	decltype(&clGetNumBytesAvail)        GetNumBytesAvail;
+	decltype(&clGetNumSerialPorts)       GetNumSerialPorts;
+	decltype(&clGetSerialPortIdentifier) GetSerialPortIdentifier;
+	decltype(&clGetSupportedBaudRates)   GetSupportedBaudRates;
+	decltype(&clSetBaudRate)             SetBaudRate;
+
+	// the cached "clser error (<code>): <text>" message of code. Texts are
+	// only requested to the backend once per process.
+	const char *ErrorMessage(int32_t code) const {
+		{
+			std::shared_lock<std::shared_mutex> lock{d_mutex};
+			if (auto it = d_messages.find(code); it != d_messages.end()) {
+				return it->second.c_str();
+			}
+		}
+
+		std::string message = "clser error (" + std::to_string(code) + "): ";
+		char        buffer[2000];
+		uint32_t    size     = sizeof(buffer);
+		int32_t     errorRes = GetErrorText(code, buffer, &size);
+		if (errorRes != 0) {
+			message += "could not get error text: error ";
+			message += std::to_string(errorRes);
+		} else {
+			message.append(buffer, strnlen(buffer, sizeof(buffer)));
+		}
+
+		std::unique_lock<std::shared_mutex> lock{d_mutex};
+		// references to unordered_map elements are stable.
+		return d_messages.try_emplace(code, std::move(message))
+		    .first->second.c_str();
+	}
+
+private:
+	mutable std::shared_mutex                        d_mutex;
+	mutable std::unordered_map<int32_t, std::string> d_messages;
+};
+
+#if !CLSERPP_DYNAMIC_BACKEND
+// the clser library linked at build time.
+inline const Backend *linked_backend() {
+	static const auto backend = [] {
+		auto res                     = std::make_unique<Backend>();
+		res->name                    = "linked";
+		res->SerialInit              = &clSerialInit;
+		res->SerialClose             = &clSerialClose;
+		res->SerialRead              = &clSerialRead;
+		res->SerialWrite             = &clSerialWrite;
+		res->FlushPort               = &clFlushPort;
+		res->GetErrorText            = &clGetErrorText;
+		res->GetManufacturerInfo     = &clGetManufacturerInfo;
+		res->GetNumBytesAvail        = &clGetNumBytesAvail;
+		res->GetNumSerialPorts       = &clGetNumSerialPorts;
+		res->GetSerialPortIdentifier = &clGetSerialPortIdentifier;
+		res->GetSupportedBaudRates   = &clGetSupportedBaudRates;
+		res->SetBaudRate             = &clSetBaudRate;
+		return res;
+	}();
+	return backend.get();
+}
+#endif
+
+template <typename Fnct>
+void resolve(
+    void *handle, const std::string &path, Fnct &fnct, const char *sym
+) {
+	fnct = reinterpret_cast<Fnct>(dlsym(handle, sym));
+	if (fnct == nullptr) {
+		throw cpptrace::runtime_error(
+		    "clser backend '" + path + "' misses symbol '" + sym + "'"
+		);
+	}
+}
+
+// dlopen()s path, symbols are bound lazily by the dynamic linker.
+inline std::unique_ptr<Backend> open_backend(const std::string &path) {
+	void *handle = dlopen(path.c_str(), RTLD_LAZY | RTLD_LOCAL);
+	if (handle == nullptr) {
+		const char *error = dlerror();
+		throw cpptrace::runtime_error(
+		    "could not load clser backend '" + path +
+		    "': " + (error != nullptr ? error : "unknown error")
+		);
+	}
+
+	auto res  = std::make_unique<Backend>();
+	res->name = path;
+	try {
+		resolve(handle, path, res->SerialInit, "clSerialInit");
+		resolve(handle, path, res->SerialClose, "clSerialClose");
+		resolve(handle, path, res->SerialRead, "clSerialRead");
+		resolve(handle, path, res->SerialWrite, "clSerialWrite");
+		resolve(handle, path, res->FlushPort, "clFlushPort");
+		resolve(handle, path, res->GetErrorText, "clGetErrorText");
+		resolve(
+		    handle,
+		    path,
+		    res->GetManufacturerInfo,
+		    "clGetManufacturerInfo"
+		);
+		resolve(handle, path, res->GetNumBytesAvail, "clGetNumBytesAvail");
+		resolve(handle, path, res->GetNumSerialPorts, "clGetNumSerialPorts");
+		resolve(
+		    handle,
+		    path,
+		    res->GetSerialPortIdentifier,
+		    "clGetSerialPortIdentifier"
+		);
+		resolve(
+		    handle,
+		    path,
+		    res->GetSupportedBaudRates,
+		    "clGetSupportedBaudRates"
+		);
+		resolve(handle, path, res->SetBaudRate, "clSetBaudRate");
+	} catch (...) {
+		dlclose(handle);
+		throw;
+	}
+	return res;
+}
+
+// Process wide set of backends. Unless SetBackends() is called, it is
+// initialized on first use from the CLSERPP_BACKENDS environment variable,
+// a ':' separated list of libraries, or defaults to the linked library
+// (or CLSERPP_DEFAULT_BACKEND with CLSERPP_DYNAMIC_BACKEND).
+class BackendRegistry {
+public:
+	static BackendRegistry &Get() {
+		static BackendRegistry registry;
+		return registry;
+	}
+
+	std::vector<const Backend *> Active() {
+		std::lock_guard<std::mutex> lock{d_mutex};
+		if (d_initialized == false) {
+			d_active      = load(defaultPaths());
+			d_initialized = true;
+		}
+		return d_active;
+	}
+
+	// an empty paths restores the default backends. A path given several
+	// times is only used once.
+	void Set(const std::vector<std::string> &paths) {
+		std::lock_guard<std::mutex> lock{d_mutex};
+		d_active      = paths.empty() ? std::vector<const Backend *>{}
+		                              : load(paths);
+		d_initialized = paths.empty() == false;
+	}
+
+private:
+	static std::vector<std::string> defaultPaths() {
+		const char *env = std::getenv("CLSERPP_BACKENDS");
+		if (env == nullptr || *env == 0) {
+			return {};
+		}
+		std::vector<std::string> res;
+		for (std::string_view left{env}; left.empty() == false;) {
+			const auto colon = left.find(':');
+			if (const auto path = left.substr(0, colon); !path.empty()) {
+				res.emplace_back(path);
+			}
+			if (colon == std::string_view::npos) {
+				break;
+			}
+			left.remove_prefix(colon + 1);
+		}
+		return res;
+	}
+
+	std::vector<const Backend *> load(const std::vector<std::string> &paths) {
+		if (paths.empty()) {
+#if CLSERPP_DYNAMIC_BACKEND
+			return load({CLSERPP_DEFAULT_BACKEND});
+#else
+			return {linked_backend()};
+#endif
+		}
+		std::vector<const Backend *> res;
+		for (const auto &path : paths) {
+			auto &loaded = d_loaded[path];
+			if (loaded == nullptr) {
+				loaded = open_backend(path);
+			}
+			if (std::find(res.begin(), res.end(), loaded.get()) == res.end()) {
+				res.push_back(loaded.get());
+			}
+		}
+		return res;
+	}
+
+	std::mutex                                      d_mutex;
+	bool                                            d_initialized = false;
+	std::vector<const Backend *>                    d_active;
+	std::map<std::string, std::unique_ptr<Backend>> d_loaded;
+};
+
+} // namespace details
+
+// Replaces the clser libraries used by Serial, i.e. to use a simulated
+// backend. Ports of several libraries are numbered one after the other.
+// Already opened ports are not affected, and an empty paths restores the
+// default backends.
+inline void SetBackends(const std::vector<std::string> &paths) {
+	details::BackendRegistry::Get().Set(paths);
+}
+
+inline std::vector<std::string> GetBackends() {
+	std::vector<std::string> res;
+	for (const auto backend : details::BackendRegistry::Get().Active()) {
+		res.push_back(backend->name);
+	}
+	return res;
+}
+
+} // namespace clserpp
+} // namespace fort
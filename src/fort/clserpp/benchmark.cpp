@@ -0,0 +1,73 @@
+// Micro benchmarks of the library hot paths, built as clserpp-benchmarks.
+// They only report timings, and are not run by ctest: build them with
+// optimizations for meaningful results.
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "escape.hpp"
+#include "reply.hpp"
+
+using namespace fort::clserpp;
+using benchmark_clock = std::chrono::steady_clock;
+
+// Compares with the std::string based parsing it replaces.
+bool benchmarkReply() {
+	const size_t ITER = 100000;
+
+	const std::string raw = "exp?\r\nexp=1200, gain=3\r\n>";
+
+	size_t sum   = 0;
+	auto   start = benchmark_clock::now();
+	for (size_t i = 0; i < ITER; ++i) {
+		std::string body = raw.substr(6, raw.size() - 9);
+		auto        pos  = body.find(',');
+		std::string exp  = body.substr(0, pos);
+		sum += std::stoi(exp.substr(exp.find('=') + 1));
+	}
+	const auto strings = benchmark_clock::now() - start;
+
+	start = benchmark_clock::now();
+	for (size_t i = 0; i < ITER; ++i) {
+		sum += Reply::Parse(raw, "exp?").Number<int>("exp").value_or(0);
+	}
+	const auto views = benchmark_clock::now() - start;
+
+	const auto perReply = [&](benchmark_clock::duration d) {
+		return std::chrono::duration<double, std::nano>(d).count() / ITER;
+	};
+	std::cout << "reply: std::string parsing " << perReply(strings)
+	          << " ns/reply, Reply parsing " << perReply(views) << " ns/reply"
+	          << std::endl;
+	return sum == 2 * ITER * 1200;
+}
+
+// throughput of the codec on mostly printable text.
+bool benchmarkEscape() {
+	std::string text(1 << 20, 'a');
+	for (size_t i = 0; i < text.size(); i += 100) {
+		text[i] = '\n';
+	}
+	std::string escaped(EscapedSizeMax(text.size()), 0);
+	std::string unescaped(EscapedSizeMax(text.size()), 0);
+
+	const auto start   = benchmark_clock::now();
+	const auto size    = Escape(text, escaped.data());
+	const auto middle  = benchmark_clock::now();
+	const auto decoded = Unescape({escaped.data(), size}, unescaped.data());
+	const auto end     = benchmark_clock::now();
+
+	const auto mbps = [&](benchmark_clock::duration d) {
+		return text.size() / std::chrono::duration<double>(d).count() / 1e6;
+	};
+	std::cout << "escape: escape " << mbps(middle - start) << " MB/s, unescape "
+	          << mbps(end - middle) << " MB/s" << std::endl;
+	return unescaped.substr(0, decoded.written) == text;
+}
+
+int main() {
+	bool ok = benchmarkReply();
+	ok      = benchmarkEscape() && ok;
+	return ok ? 0 : 1;
+}
@@ -7,7 +7,7 @@
 
 TEST(Buffer, Escaping) {
 
-	std::string escaped{R"(\n\r\t\foo)"}, parsed{"\n\r\t\\foo"};
+	std::string escaped{R"(\n\r\t\\foo)"}, parsed{"\n\r\t\\foo"};
 
 	EXPECT_EQ(fort::clserpp::details::escape(parsed), escaped);
 	EXPECT_EQ(fort::clserpp::details::parse_ascii(escaped), parsed);
@@ -54,6 +54,6 @@ TEST(Buffer, FormattingNonPrintableCharacter) {
 	EXPECT_EQ(
 	    out.str(),
 	    "buffer 4 bytes:\n"
-	    "0000 | 0d0a00af          .                   | \\r\\n\\x0\\x175\n"
+	    "0000 | 0d0a00af          .                   | \\r\\n\\x00\\xaf\n"
 	);
 }
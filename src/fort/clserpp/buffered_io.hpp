@@ -1,17 +1,21 @@
 #pragma once
 
 #include <algorithm>
+#include <chrono>
 #include <cstddef>
+#include <deque>
 #include <iterator>
 #include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
 
 #include <cpptrace/exceptions.hpp>
 
 #include "buffer.hpp"
 #include "exceptions.hpp"
-
-#include <spdlog/spdlog.h>
+#include "hexdump.hpp"
+#include "log.hpp"
 
 namespace fort {
 namespace clserpp {
@@ -54,12 +58,18 @@ public:
 		return std::distance(d_begin, d_end);
 	}
 
-	std::vector<char>::iterator d_begin, d_end;
+	Buffer::iterator d_begin, d_end;
 };
 } // namespace details
 
 class EndOfStream {};
 
+struct ArrivalTimes {
+	std::chrono::steady_clock::time_point first, last;
+};
+
+// A ReadBuffer is not thread-safe. It is meant to be owned by the single
+// reader thread of a Reader, see Serial for the concurrency model.
 template <typename Reader> class ReadBuffer {
 public:
 	ReadBuffer(std::shared_ptr<Reader> reader)
@@ -73,87 +83,108 @@ public:
 		return std::distance(d_head, d_tail);
 	}
 
+	// copies at most size already buffered bytes to out, returns the number
+	// of bytes copied.
+	size_t Drain(char *out, size_t size) {
+		size = std::min(size, BytesAvailable());
+		std::copy(d_head, d_head + size, out);
+		d_head += size;
+		return size;
+	}
+
 	std::string
 	ReadUntil(uint32_t timeout_ms, const std::string &delim = "\n") {
+		return std::string{ReadUntilView(timeout_ms, delim)};
+	}
+
+	// same as ReadUntil(), but returns a view in the buffer, which is only
+	// valid until the next read.
+	std::string_view
+	ReadUntilView(uint32_t timeout_ms, const std::string &delim = "\n") {
 		size_t available = d_reader->BytesAvailable();
-		SPDLOG_DEBUG(
+		CLSERPP_DEBUG(
+		    IO,
 		    "ReadLine head:{} tail:{} available:{} left: '{}'",
 		    std::distance(d_buffer.begin(), d_head),
 		    std::distance(d_buffer.begin(), d_tail),
 		    available,
-		    std::string(d_head, d_tail)
+		    Escaped(pending())
 		);
 
 		bool timeouted = false;
 		while (true) {
 			// test if we can send back data
-			const auto pos =
-			    std::search(d_head, d_tail, delim.cbegin(), delim.cend());
-			if (pos != d_tail) {
-				SPDLOG_DEBUG(
-				    " --- Found delim at {}",
-				    std::distance(d_buffer.begin(), pos)
-				);
-				std::string res{d_head, pos + delim.size()};
-				d_head = pos + delim.size();
-				return res;
+			if (auto line = extract(delim); line.has_value()) {
+				return line.value();
 			} else if (timeouted) {
-				SPDLOG_DEBUG(" --- timeouted");
+				CLSERPP_DEBUG(IO, " --- timeouted");
 				throw IOTimeout(std::distance(d_head, d_tail));
 			}
 
-			available =
-			    std::max(delim.size(), size_t(d_reader->BytesAvailable()));
-
-			size_t left        = std::distance(d_tail, d_buffer.end());
-			bool   atBeginning = d_head == d_buffer.begin();
-			SPDLOG_DEBUG(
-			    " --- remaining {}, at beginning: {}, will rotate: {}",
-			    left,
-			    atBeginning,
-			    left < available && !atBeginning
+			available = reserve(
+			    std::max(delim.size(), size_t(d_reader->BytesAvailable()))
 			);
-			// make room if possible
-			if (left < available) {
-				if (atBeginning) {
-					throw cpptrace::runtime_error("read buffer too small");
-				}
-
-				SPDLOG_DEBUG(" --- wrapping ring buffer");
-				size_t available = std::distance(d_head, d_tail);
-				std::copy(d_head, d_tail, d_buffer.begin());
-				d_head = d_buffer.begin();
-				d_tail = d_head + available;
-			}
 
 			// read more if possible
 			details::BufferView segment{d_buffer, d_tail, d_tail + available};
 
 			try {
-				SPDLOG_DEBUG(" --- reading {} more", available);
+				CLSERPP_DEBUG(IO, " --- reading {} more", available);
 				d_reader->Read(segment, timeout_ms);
-				d_tail += available;
+				received(available);
 				timeouted = false;
 			} catch (const IOTimeout &timeout) {
-				SPDLOG_DEBUG(
+				CLSERPP_DEBUG(
+				    IO,
 				    " --- timeouted after {} bytes, head: {}, tail: {} == '{}' "
 				    "{}",
 				    timeout.bytes(),
 				    std::distance(d_buffer.begin(), d_head),
 				    std::distance(d_buffer.begin(), d_tail),
-				    std::string(d_head, d_tail),
-				    d_buffer
+				    Escaped(pending()),
+				    Hexdump(d_buffer)
 				);
 				if (timeout.bytes() == 0) {
 
 					throw IOTimeout(std::distance(d_head, d_tail));
 				}
 				timeouted = true;
-				d_tail += timeout.bytes();
+				received(timeout.bytes());
 			}
 		}
 	}
 
+	class LineRange;
+
+	// Lazy range over every complete line already buffered, or immediately
+	// available from the Reader, which is read in as few Read() as possible.
+	// It ends without throwing when no complete line is pending. Lines are
+	// views in the buffer, only valid until the iterator is incremented.
+	LineRange Lines(uint32_t timeout_ms, const std::string &delim = "\n") {
+		return LineRange{*this, delim, timeout_ms};
+	}
+
+	// Arrival times of the first and last bytes of view, which must be a
+	// line or a part of a line returned since the last read. Bytes are
+	// stamped when the Reader returns them.
+	ArrivalTimes Arrival(std::string_view view) const {
+		const size_t tail = d_tail - d_buffer.begin();
+		if (view.empty() || view.data() < d_buffer.data() ||
+		    view.data() + view.size() > d_buffer.data() + tail) {
+			throw cpptrace::logic_error("view is not in the read buffer");
+		}
+		const size_t   begin = view.data() - d_buffer.data();
+		const uint64_t first = d_received - (tail - begin);
+		const uint64_t last  = first + view.size() - 1;
+		return {.first = arrival(first), .last = arrival(last)};
+	}
+
+	void Clear() {
+		d_head = d_buffer.begin();
+		d_tail = d_buffer.begin();
+		d_stamps.clear();
+	}
+
 	std::string Reminder() const {
 		return std::string(d_head, d_tail);
 	}
@@ -165,11 +196,194 @@ public:
 private:
 	const static size_t BUFFER_SIZE = 4096;
 
+	// bytes up to end, excluded, of the received stream arrived at time.
+	struct Stamp {
+		uint64_t                              end;
+		std::chrono::steady_clock::time_point time;
+	};
+
+	void received(size_t size) {
+		if (size == 0) {
+			return;
+		}
+		d_tail += size;
+		d_received += size;
+		// stamps of consumed bytes are no longer needed.
+		const uint64_t head = d_received - std::distance(d_head, d_tail);
+		while (d_stamps.empty() == false && d_stamps.front().end <= head) {
+			d_stamps.pop_front();
+		}
+		d_stamps.push_back({
+		    .end  = d_received,
+		    .time = std::chrono::steady_clock::now(),
+		});
+	}
+
+	std::chrono::steady_clock::time_point arrival(uint64_t offset) const {
+		const auto it = std::upper_bound(
+		    d_stamps.begin(),
+		    d_stamps.end(),
+		    offset,
+		    [](uint64_t offset, const Stamp &s) { return offset < s.end; }
+		);
+		if (it == d_stamps.end()) {
+			throw cpptrace::logic_error("no arrival time for consumed bytes");
+		}
+		return it->time;
+	}
+
+	std::optional<std::string_view> extract(const std::string &delim) {
+		const auto pos =
+		    std::search(d_head, d_tail, delim.cbegin(), delim.cend());
+		if (pos == d_tail) {
+			return std::nullopt;
+		}
+		CLSERPP_DEBUG(
+		    IO,
+		    " --- Found delim at {}",
+		    std::distance(d_buffer.begin(), pos)
+		);
+		std::string_view res{
+		    d_buffer.data() + std::distance(d_buffer.begin(), d_head),
+		    size_t(std::distance(d_head, pos)) + delim.size(),
+		};
+		d_head = pos + delim.size();
+		return res;
+	}
+
+	// next complete line, reading only the bytes the Reader reports as
+	// available.
+	std::optional<std::string_view>
+	nextPending(const std::string &delim, uint32_t timeout_ms) {
+		while (true) {
+			if (auto line = extract(delim); line.has_value()) {
+				return line;
+			}
+			const size_t pending = d_reader->BytesAvailable();
+			if (pending == 0) {
+				return std::nullopt;
+			}
+			const size_t size = reserve(pending);
+
+			details::BufferView segment{d_buffer, d_tail, d_tail + size};
+			try {
+				d_reader->Read(segment, timeout_ms);
+				received(size);
+			} catch (const IOTimeout &timeout) {
+				received(timeout.bytes());
+				if (timeout.bytes() == 0) {
+					return std::nullopt;
+				}
+			}
+		}
+	}
+
+	std::string_view pending() const {
+		return {
+		    d_buffer.data() + (d_head - d_buffer.begin()),
+		    size_t(d_tail - d_head),
+		};
+	}
+
+	// makes room for size bytes after d_tail, moving the buffered bytes to
+	// the beginning if needed. Returns the number of bytes that fit.
+	size_t reserve(size_t size) {
+		if (size_t(std::distance(d_tail, d_buffer.end())) < size &&
+		    d_head != d_buffer.begin()) {
+			CLSERPP_DEBUG(IO, " --- wrapping ring buffer");
+			size_t buffered = std::distance(d_head, d_tail);
+			std::copy(d_head, d_tail, d_buffer.begin());
+			d_head = d_buffer.begin();
+			d_tail = d_head + buffered;
+		}
+		const size_t left = std::distance(d_tail, d_buffer.end());
+		if (left == 0) {
+			throw cpptrace::runtime_error("read buffer too small");
+		}
+		return std::min(size, left);
+	}
+
 	std::shared_ptr<Reader> d_reader = nullptr;
 
 	clserpp::Buffer           d_buffer = clserpp::Buffer{BUFFER_SIZE};
 	clserpp::Buffer::iterator d_head   = d_buffer.begin(),
 	                          d_tail   = d_buffer.begin();
+
+	uint64_t d_received = 0;
+	// pooled, as stamps are pushed and popped for every read.
+	std::deque<Stamp, PoolAllocator<Stamp>> d_stamps;
+};
+
+template <typename Reader> class ReadBuffer<Reader>::LineRange {
+public:
+	class iterator {
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type        = std::string_view;
+		using difference_type   = std::ptrdiff_t;
+		using pointer           = const std::string_view *;
+		using reference         = const std::string_view &;
+
+		reference operator*() const {
+			return d_range->d_current.value();
+		}
+
+		pointer operator->() const {
+			return &d_range->d_current.value();
+		}
+
+		iterator &operator++() {
+			d_range->next();
+			return *this;
+		}
+
+		bool operator==(const iterator &other) const {
+			return done() == other.done();
+		}
+
+		bool operator!=(const iterator &other) const {
+			return !(*this == other);
+		}
+
+	private:
+		friend class LineRange;
+
+		iterator(LineRange *range)
+		    : d_range{range} {}
+
+		bool done() const {
+			return d_range == nullptr ||
+			       d_range->d_current.has_value() == false;
+		}
+
+		LineRange *d_range;
+	};
+
+	iterator begin() {
+		next();
+		return iterator{this};
+	}
+
+	iterator end() {
+		return iterator{nullptr};
+	}
+
+private:
+	friend class ReadBuffer<Reader>;
+
+	LineRange(ReadBuffer &buffer, const std::string &delim, uint32_t timeout)
+	    : d_buffer{buffer}
+	    , d_delim{delim}
+	    , d_timeout{timeout} {}
+
+	void next() {
+		d_current = d_buffer.nextPending(d_delim, d_timeout);
+	}
+
+	ReadBuffer                     &d_buffer;
+	std::string                     d_delim;
+	uint32_t                        d_timeout;
+	std::optional<std::string_view> d_current;
 };
 } // namespace clserpp
 } // namespace fort
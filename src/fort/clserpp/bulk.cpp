@@ -0,0 +1,290 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <deque>
+#include <memory>
+
+#include "bulk.hpp"
+#include "exceptions.hpp"
+
+using namespace fort::clserpp;
+
+class MockDevice {
+public:
+	// every stallEvery-th write only accepts half of its bytes.
+	size_t stallEvery = 0;
+	// when set, every write only accepts up to acceptAtMost bytes.
+	size_t acceptAtMost = 0;
+	// when set, the device answers each block of blockSize bytes, with a
+	// NAK for the first naks blocks.
+	size_t blockSize = 0;
+	size_t naks      = 0;
+	size_t expected  = 0;
+	// when set, the first transmission of every block is answered by a NAK.
+	bool nakEveryBlockOnce = false;
+
+	std::string received;
+	size_t      writes = 0;
+
+	template <typename Container>
+	void Write(const Container &buf, uint32_t timeout_ms) {
+		++writes;
+		size_t size = buf.size();
+		if (stallEvery > 0 && writes % stallEvery == 0) {
+			size /= 2;
+		}
+		if (acceptAtMost > 0) {
+			size = std::min(size, acceptAtMost);
+		}
+		d_block.append(&buf[0], size);
+		if (blockSize == 0) {
+			received += d_block;
+			d_block.clear();
+		} else if (d_block.size() == blockSize ||
+		           received.size() + d_block.size() == expected) {
+			if (naks > 0) {
+				--naks;
+				reply("NAK\r\n");
+			} else if (nakEveryBlockOnce && d_naked != received.size()) {
+				d_naked = received.size();
+				reply("NAK\r\n");
+			} else {
+				received += d_block;
+				reply("ACK\r\n");
+			}
+			d_block.clear();
+		}
+		if (size < buf.size()) {
+			throw IOTimeout(size);
+		}
+	}
+
+	template <typename Container>
+	void Read(Container &buf, uint32_t timeout_ms) {
+		size_t read = 0;
+		for (; read < buf.size() && d_output.empty() == false; ++read) {
+			buf[read] = d_output.front();
+			d_output.pop_front();
+		}
+		if (read < buf.size()) {
+			throw IOTimeout(read);
+		}
+	}
+
+	uint32_t BytesAvailable() const {
+		return d_output.size();
+	}
+
+	void Flush() {
+		d_output.clear();
+	}
+
+	void reply(const std::string &value) {
+		d_output.insert(d_output.end(), value.begin(), value.end());
+	}
+
+private:
+	std::string      d_block;
+	std::deque<char> d_output;
+	size_t           d_naked = size_t(-1);
+};
+
+class BulkTest : public ::testing::Test {
+protected:
+	void SetUp() override {
+		device = std::make_shared<MockDevice>();
+		buffer = std::make_unique<ReadBuffer<MockDevice>>(device);
+
+		for (size_t i = 0; i < 1000; ++i) {
+			data.push_back(char(i % 251));
+		}
+
+		opts.baudrate   = CL_BAUDRATE_921600;
+		opts.pace       = false;
+		opts.timeout_ms = 10;
+	}
+
+	std::shared_ptr<MockDevice>             device;
+	std::unique_ptr<ReadBuffer<MockDevice>> buffer;
+	std::string                             data;
+	BulkOptions                             opts;
+};
+
+TEST(BulkChunks, AreSizedForBaudrate) {
+	using namespace std::chrono_literals;
+	EXPECT_EQ(details::chunk_size(CL_BAUDRATE_9600, 50ms), 48);
+	EXPECT_EQ(details::chunk_size(CL_BAUDRATE_115200, 50ms), 576);
+	EXPECT_EQ(details::chunk_size(CL_BAUDRATE_9600, 1ms), 16);
+	EXPECT_EQ(details::chunk_size(CL_BAUDRATE_921600, 1000ms), 4096);
+}
+
+TEST_F(BulkTest, UploadsInChunks) {
+	opts.baudrate = CL_BAUDRATE_115200;
+
+	std::vector<size_t> progress;
+	opts.progress = [&progress](size_t transferred, size_t total) {
+		EXPECT_EQ(total, 1000);
+		progress.push_back(transferred);
+	};
+
+	EXPECT_EQ(Upload(*device, *buffer, data.data(), data.size(), opts), 1000);
+	EXPECT_EQ(device->received, data);
+	EXPECT_EQ(progress, std::vector<size_t>({576, 1000}));
+}
+
+TEST_F(BulkTest, UploadResumesAfterTimeouts) {
+	device->stallEvery = 2;
+
+	EXPECT_EQ(Upload(*device, *buffer, data.data(), data.size(), opts), 1000);
+	EXPECT_EQ(device->received, data);
+}
+
+TEST_F(BulkTest, UploadReportsTransferredBytesWhenGivingUp) {
+	device->stallEvery = 1;
+	opts.maxRetries    = 2;
+
+	try {
+		Upload(*device, *buffer, data.data(), data.size(), opts);
+		ADD_FAILURE() << "should have thrown IOTimeout";
+	} catch (const IOTimeout &e) {
+		EXPECT_EQ(e.bytes(), device->received.size());
+		device->stallEvery = 0;
+		EXPECT_EQ(
+		    Upload(*device, *buffer, data.data(), data.size(), opts, e.bytes()),
+		    1000
+		);
+	}
+	EXPECT_EQ(device->received, data);
+}
+
+TEST_F(BulkTest, UploadGivesUpOnADroppingLink) {
+	device->acceptAtMost = 10;
+
+	try {
+		Upload(*device, *buffer, data.data(), data.size(), opts);
+		ADD_FAILURE() << "should have thrown IOTimeout";
+	} catch (const IOTimeout &e) {
+		EXPECT_EQ(e.bytes(), (opts.maxBlockRetries + 1) * 10);
+		EXPECT_EQ(e.bytes(), device->received.size());
+	}
+}
+
+TEST_F(BulkTest, UploadRetransmitsNotAcknowledgedBlocks) {
+	opts.acknowledgement            = BlockAcknowledgement{};
+	opts.acknowledgement->blockSize = 128;
+	device->blockSize               = 128;
+	device->expected                = data.size();
+	device->naks                    = 2;
+
+	EXPECT_EQ(Upload(*device, *buffer, data.data(), data.size(), opts), 1000);
+	EXPECT_EQ(device->received, data);
+}
+
+TEST_F(BulkTest, UploadRetransmitsEveryBlockWithinItsRetries) {
+	opts.acknowledgement            = BlockAcknowledgement{};
+	opts.acknowledgement->blockSize = 128;
+	device->blockSize               = 128;
+	device->expected                = data.size();
+	device->nakEveryBlockOnce       = true;
+
+	EXPECT_EQ(Upload(*device, *buffer, data.data(), data.size(), opts), 1000);
+	EXPECT_EQ(device->received, data);
+}
+
+TEST_F(BulkTest, UploadsMappedFile) {
+	char path[] = "/tmp/clserpp-bulk-XXXXXX";
+	int  fd     = mkstemp(path);
+	ASSERT_GE(fd, 0);
+	ASSERT_EQ(::write(fd, data.data(), data.size()), data.size());
+	::close(fd);
+
+	{
+		MappedFile file{path};
+		EXPECT_EQ(file.size(), data.size());
+		EXPECT_EQ(Upload(*device, *buffer, file, opts), 1000);
+	}
+	std::remove(path);
+
+	EXPECT_EQ(device->received, data);
+	EXPECT_THROW({ MappedFile{path}; }, cpptrace::system_error);
+}
+
+TEST_F(BulkTest, DownloadsIntoSink) {
+	device->reply("READY\r\n" + data);
+	EXPECT_EQ(buffer->ReadUntil(10, "\r\n"), "READY\r\n");
+
+	std::string sunk;
+	const auto  sink = [&sunk](const char *data, size_t size) {
+		sunk.append(data, size);
+	};
+
+	opts.baudrate = CL_BAUDRATE_9600;
+	EXPECT_EQ(Download(*device, *buffer, data.size(), sink, opts), 1000);
+	EXPECT_EQ(sunk, data);
+}
+
+TEST_F(BulkTest, DownloadAcknowledgesBlocks) {
+	device->reply(data);
+	opts.acknowledgement            = BlockAcknowledgement{};
+	opts.acknowledgement->blockSize = 300;
+
+	std::string sunk;
+	const auto  sink = [&sunk](const char *data, size_t size) {
+		sunk.append(data, size);
+	};
+
+	EXPECT_EQ(Download(*device, *buffer, data.size(), sink, opts), 1000);
+	EXPECT_EQ(sunk, data);
+	EXPECT_EQ(device->received, "ACK\r\nACK\r\nACK\r\nACK\r\n");
+}
+
+TEST_F(BulkTest, DownloadReportsTransferredBytesWhenGivingUp) {
+	device->reply(data.substr(0, 600));
+
+	std::string sunk;
+	const auto  sink = [&sunk](const char *data, size_t size) {
+		sunk.append(data, size);
+	};
+
+	try {
+		Download(*device, *buffer, data.size(), sink, opts);
+		ADD_FAILURE() << "should have thrown IOTimeout";
+	} catch (const IOTimeout &e) {
+		EXPECT_EQ(e.bytes(), 600);
+		device->reply(data.substr(600));
+		EXPECT_EQ(
+		    Download(*device, *buffer, data.size(), sink, opts, e.bytes()),
+		    1000
+		);
+	}
+	EXPECT_EQ(sunk, data);
+}
+
+TEST_F(BulkTest, DownloadRefusesIncompleteBlocks) {
+	// the end of the second block is lost.
+	device->reply(data.substr(0, 400));
+	opts.acknowledgement            = BlockAcknowledgement{};
+	opts.acknowledgement->blockSize = 300;
+
+	std::string sunk;
+	const auto  sink = [&sunk](const char *data, size_t size) {
+		sunk.append(data, size);
+	};
+
+	try {
+		Download(*device, *buffer, data.size(), sink, opts);
+		ADD_FAILURE() << "should have thrown IOTimeout";
+	} catch (const IOTimeout &e) {
+		EXPECT_EQ(e.bytes(), 300);
+		EXPECT_EQ(sunk, data.substr(0, 300));
+		EXPECT_EQ(device->received, "ACK\r\nNAK\r\n");
+		device->reply(data.substr(300));
+		EXPECT_EQ(
+		    Download(*device, *buffer, data.size(), sink, opts, e.bytes()),
+		    1000
+		);
+	}
+	EXPECT_EQ(sunk, data);
+	EXPECT_EQ(device->received, "ACK\r\nNAK\r\nACK\r\nACK\r\nACK\r\n");
+}
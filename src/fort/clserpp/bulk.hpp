@@ -0,0 +1,390 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <functional>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cpptrace/exceptions.hpp>
+
+#include <spdlog/spdlog.h>
+
+#include "buffer.hpp"
+#include "buffered_io.hpp"
+#include "clser.h"
+#include "details.hpp"
+#include "exceptions.hpp"
+#include "log.hpp"
+
+namespace fort {
+namespace clserpp {
+
+// Read-only memory mapping of a whole file, used as a bulk upload source.
+class MappedFile {
+public:
+	MappedFile(const std::string &path) {
+		int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0) {
+			throw cpptrace::system_error(errno, "could not open " + path);
+		}
+		struct stat st;
+		if (::fstat(fd, &st) != 0) {
+			int err = errno;
+			::close(fd);
+			throw cpptrace::system_error(err, "could not stat " + path);
+		}
+		d_size = st.st_size;
+		if (d_size > 0) {
+			void *data =
+			    ::mmap(nullptr, d_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (data == MAP_FAILED) {
+				int err = errno;
+				::close(fd);
+				throw cpptrace::system_error(err, "could not map " + path);
+			}
+			::madvise(data, d_size, MADV_SEQUENTIAL);
+			d_data = static_cast<const char *>(data);
+		}
+		::close(fd);
+	}
+
+	~MappedFile() {
+		if (d_data != nullptr) {
+			::munmap(const_cast<char *>(d_data), d_size);
+		}
+	}
+
+	const char *data() const {
+		return d_data;
+	}
+
+	size_t size() const {
+		return d_size;
+	}
+
+private:
+	MappedFile(const MappedFile &other)            = delete;
+	MappedFile &operator=(const MappedFile &other) = delete;
+	MappedFile(MappedFile &&other)                 = delete;
+	MappedFile &operator=(MappedFile &&other)      = delete;
+
+	const char *d_data = nullptr;
+	size_t      d_size = 0;
+};
+
+// Optional per-block handshake: after each block, the receiver answers with
+// ack or nak, terminated by delimiter. A nak or a missing answer makes the
+// sender retransmit the block. The receiver answers nak when the link goes
+// quiet in the middle of a block, i.e. when bytes were lost.
+struct BlockAcknowledgement {
+	size_t      blockSize  = 256;
+	std::string ack        = "ACK";
+	std::string nak        = "NAK";
+	std::string delimiter  = "\r\n";
+	uint32_t    timeout_ms = 1000;
+};
+
+struct BulkOptions {
+	clBaudrate_e              baudrate = CL_BAUDRATE_9600;
+	std::chrono::milliseconds chunkDuration{50};
+	// limits the sending rate to the line rate, so the driver queue never
+	// holds more than a chunk.
+	bool     pace       = true;
+	uint32_t timeout_ms = 1000;
+	// number of consecutive failed attempts tolerated before giving up.
+	size_t maxRetries = 3;
+	// number of failed attempts tolerated within an acknowledged block, or
+	// the whole transfer without acknowledgement, even if each of them made
+	// some progress.
+	size_t maxBlockRetries = 16;
+
+	std::optional<BlockAcknowledgement> acknowledgement = std::nullopt;
+
+	std::function<void(size_t transferred, size_t total)> progress;
+};
+
+using BulkSink = std::function<void(const char *data, size_t size)>;
+
+namespace details {
+
+template <typename T> class Span {
+public:
+	Span(T *data, size_t size)
+	    : d_data{data}
+	    , d_size{size} {}
+
+	T &operator[](size_t i) const {
+		return d_data[i];
+	}
+
+	size_t size() const {
+		return d_size;
+	}
+
+private:
+	T     *d_data;
+	size_t d_size;
+};
+
+// bytes sent in duration at baudrate, assuming 10 bits per byte (8N1).
+inline size_t
+chunk_size(clBaudrate_e baudrate, std::chrono::milliseconds duration) {
+	const size_t bytes =
+	    size_t(baudrate_value(baudrate)) * duration.count() / 10000;
+	return std::clamp(bytes, size_t(16), size_t(4096));
+}
+
+class Pacer {
+public:
+	Pacer(clBaudrate_e baudrate, bool enabled = true)
+	    : d_enabled{enabled}
+	    , d_bytesPerSecond{baudrate_value(baudrate) / 10.0} {
+		Reset();
+	}
+
+	void Reset() {
+		d_start = std::chrono::steady_clock::now();
+		d_bytes = 0;
+	}
+
+	void Sent(size_t bytes) {
+		if (d_enabled == false) {
+			return;
+		}
+		d_bytes += bytes;
+		const std::chrono::duration<double> elapsed{d_bytes / d_bytesPerSecond};
+		std::this_thread::sleep_until(
+		    d_start +
+		    std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+		);
+	}
+
+private:
+	bool                                  d_enabled;
+	double                                d_bytesPerSecond;
+	std::chrono::steady_clock::time_point d_start;
+	size_t                                d_bytes;
+};
+
+// Bounds the consecutive failed attempts without progress, and all the
+// failed attempts of a block, so a link dropping after a few bytes every
+// time also gives up.
+class Retries {
+public:
+	Retries(size_t maximum, size_t blockMaximum, size_t &transferred)
+	    : d_maximum{maximum}
+	    , d_blockMaximum{blockMaximum}
+	    , d_transferred{transferred} {}
+
+	void Failed(bool progress) {
+		d_count = progress ? 0 : d_count + 1;
+		if (d_count > d_maximum || ++d_blockCount > d_blockMaximum) {
+			throw IOTimeout(d_transferred);
+		}
+	}
+
+	void Succeeded() {
+		d_count = 0;
+	}
+
+	void NextBlock() {
+		d_count      = 0;
+		d_blockCount = 0;
+	}
+
+private:
+	size_t  d_maximum, d_blockMaximum;
+	size_t &d_transferred;
+	size_t  d_count = 0, d_blockCount = 0;
+};
+
+template <typename Port>
+bool wait_acknowledgement(
+    ReadBuffer<Port> &buffer, const BlockAcknowledgement &ack
+) {
+	try {
+		const auto reply = buffer.ReadUntil(ack.timeout_ms, ack.delimiter);
+		if (reply.find(ack.ack) != std::string::npos) {
+			return true;
+		}
+		CLSERPP_DEBUG(
+		    BULK,
+		    "bulk block not acknowledged: '{}'",
+		    Escaped(reply)
+		);
+	} catch (const IOTimeout &) {
+		CLSERPP_DEBUG(BULK, "bulk block acknowledgement timeouted");
+	}
+	return false;
+}
+
+} // namespace details
+
+// Streams [data+offset, data+size[ to port in chunks of
+// opts.chunkDuration wire time. Timeouts resume from the bytes reported by
+// IOTimeout. When all retries are exhausted, the IOTimeout thrown reports
+// the total number of bytes transferred, which could be passed back as
+// offset to resume the transfer. Returns the number of bytes transferred.
+template <typename Port>
+size_t Upload(
+    Port              &port,
+    ReadBuffer<Port>  &buffer,
+    const char        *data,
+    size_t             size,
+    const BulkOptions &opts,
+    size_t             offset = 0
+) {
+	const auto chunkSize =
+	    details::chunk_size(opts.baudrate, opts.chunkDuration);
+	details::Pacer   pacer{opts.baudrate, opts.pace};
+	details::Retries retries{opts.maxRetries, opts.maxBlockRetries, offset};
+	details::Retries retransmissions{opts.maxRetries, opts.maxRetries, offset};
+
+	while (offset < size) {
+		const size_t blockStart = offset;
+		const size_t blockEnd =
+		    opts.acknowledgement.has_value()
+		        ? std::min(size, offset + opts.acknowledgement->blockSize)
+		        : size;
+
+		while (offset < blockEnd) {
+			const size_t chunk = std::min(chunkSize, blockEnd - offset);
+			try {
+				port.Write(
+				    details::Span<const char>{data + offset, chunk},
+				    opts.timeout_ms
+				);
+				offset += chunk;
+				pacer.Sent(chunk);
+				retries.Succeeded();
+			} catch (const IOTimeout &e) {
+				CLSERPP_DEBUG(
+				    BULK,
+				    "bulk upload timeouted at {} after {} bytes",
+				    offset,
+				    e.bytes()
+				);
+				offset += e.bytes();
+				pacer.Reset();
+				retries.Failed(e.bytes() > 0);
+			}
+			if (opts.progress) {
+				opts.progress(offset, size);
+			}
+		}
+
+		if (opts.acknowledgement.has_value() == false) {
+			continue;
+		}
+
+		pacer.Reset();
+		if (details::wait_acknowledgement(buffer, *opts.acknowledgement)) {
+			retries.NextBlock();
+			retransmissions.NextBlock();
+			continue;
+		}
+		offset = blockStart;
+		retransmissions.Failed(false);
+		if (opts.progress) {
+			opts.progress(offset, size);
+		}
+	}
+	return offset;
+}
+
+template <typename Port>
+size_t Upload(
+    Port              &port,
+    ReadBuffer<Port>  &buffer,
+    const MappedFile  &file,
+    const BulkOptions &opts,
+    size_t             offset = 0
+) {
+	return Upload(port, buffer, file.data(), file.size(), opts, offset);
+}
+
+// Streams size bytes from port to sink, starting at offset. Bytes already
+// buffered in buffer are delivered first. With an acknowledgement, blocks
+// are only delivered to sink once complete and answered with ack, a block
+// interrupted by a timeout is discarded and answered with nak. Resumption
+// follows the same rules as Upload(), from the bytes delivered to sink.
+template <typename Port>
+size_t Download(
+    Port              &port,
+    ReadBuffer<Port>  &buffer,
+    size_t             size,
+    const BulkSink    &sink,
+    const BulkOptions &opts,
+    size_t             offset = 0
+) {
+	const auto chunkSize =
+	    details::chunk_size(opts.baudrate, opts.chunkDuration);
+	details::Retries retries{opts.maxRetries, opts.maxBlockRetries, offset};
+
+	const auto &acknowledgement = opts.acknowledgement;
+	const size_t blockSize =
+	    acknowledgement.has_value() ? acknowledgement->blockSize : chunkSize;
+	Buffer                block{blockSize};
+	std::optional<Buffer> ack, nak;
+	if (acknowledgement.has_value()) {
+		ack = Buffer{acknowledgement->ack + acknowledgement->delimiter};
+		nak = Buffer{acknowledgement->nak + acknowledgement->delimiter};
+	}
+
+	// bytes of the current block not yet delivered to sink.
+	size_t filled = 0;
+	while (offset < size) {
+		const size_t blockEnd = std::min(blockSize, size - offset);
+		const size_t wanted   = std::min(chunkSize, blockEnd - filled);
+		char        *dest     = block.data() + filled;
+		size_t       got      = buffer.Drain(dest, wanted);
+		try {
+			details::Span<char> segment{dest + got, wanted - got};
+			port.Read(segment, opts.timeout_ms);
+			got = wanted;
+			retries.Succeeded();
+		} catch (const IOTimeout &e) {
+			CLSERPP_DEBUG(
+			    BULK,
+			    "bulk download timeouted at {} after {} bytes",
+			    offset + filled + got,
+			    e.bytes()
+			);
+			got += e.bytes();
+			if (nak.has_value() && got == 0 && filled > 0) {
+				CLSERPP_DEBUG(BULK, "bulk block at {} is incomplete", offset);
+				port.Write(nak.value(), opts.timeout_ms);
+				filled = 0;
+			}
+			retries.Failed(got > 0);
+		}
+
+		filled += got;
+		if (ack.has_value() == false || filled == blockEnd) {
+			if (filled > 0) {
+				sink(block.data(), filled);
+				offset += filled;
+				filled = 0;
+			}
+			if (ack.has_value()) {
+				port.Write(ack.value(), opts.timeout_ms);
+				retries.NextBlock();
+			}
+		}
+		if (opts.progress) {
+			opts.progress(offset + filled, size);
+		}
+	}
+	return offset;
+}
+
+} // namespace clserpp
+} // namespace fort
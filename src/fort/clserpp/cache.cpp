@@ -0,0 +1,196 @@
+#include <gtest/gtest.h>
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "cache.hpp"
+#include "exceptions.hpp"
+
+using namespace fort::clserpp;
+
+class RegisterCamera {
+public:
+	// when holding, Write() blocks until Release() is called.
+	void Hold() {
+		std::lock_guard<std::mutex> lock{d_mutex};
+		d_holding = true;
+	}
+
+	void Release() {
+		{
+			std::lock_guard<std::mutex> lock{d_mutex};
+			d_holding = false;
+		}
+		d_condition.notify_all();
+	}
+
+	void WaitTransactions(size_t count) {
+		std::unique_lock<std::mutex> lock{d_mutex};
+		d_condition.wait(lock, [&]() { return d_transactions >= count; });
+	}
+
+	size_t Transactions() {
+		std::lock_guard<std::mutex> lock{d_mutex};
+		return d_transactions;
+	}
+
+	template <typename Container>
+	void Write(const Container &buf, uint32_t timeout_ms) {
+		std::unique_lock<std::mutex> lock{d_mutex};
+		++d_transactions;
+		d_condition.notify_all();
+		d_condition.wait(lock, [this]() { return d_holding == false; });
+
+		// strips the CR termination.
+		const std::string line(&buf[0], buf.size() - 1);
+		if (const auto pos = line.find('='); pos != std::string::npos) {
+			d_registers[line.substr(0, pos)] = line.substr(pos + 1);
+			reply("OK");
+		} else if (line.back() == '?') {
+			const auto name = line.substr(0, line.size() - 1);
+			reply(name + "=" + d_registers[name]);
+		}
+	}
+
+	template <typename Container>
+	void Read(Container &buf, uint32_t timeout_ms) {
+		std::lock_guard<std::mutex> lock{d_mutex};
+		size_t                      read = 0;
+		for (; read < buf.size() && d_output.empty() == false; ++read) {
+			buf[read] = d_output.front();
+			d_output.pop_front();
+		}
+		if (read < buf.size()) {
+			throw IOTimeout(read);
+		}
+	}
+
+	uint32_t BytesAvailable() {
+		std::lock_guard<std::mutex> lock{d_mutex};
+		return d_output.size();
+	}
+
+	void Flush() {
+		std::lock_guard<std::mutex> lock{d_mutex};
+		d_output.clear();
+		++d_generation;
+	}
+
+	uint64_t Generation() {
+		std::lock_guard<std::mutex> lock{d_mutex};
+		return d_generation;
+	}
+
+private:
+	void reply(const std::string &value) {
+		for (char c : value + "\r\n>") {
+			d_output.push_back(c);
+		}
+	}
+
+	std::mutex                         d_mutex;
+	std::condition_variable            d_condition;
+	bool                               d_holding      = false;
+	size_t                             d_transactions = 0;
+	uint64_t                           d_generation   = 1;
+	std::deque<char>                   d_output;
+	std::map<std::string, std::string> d_registers{
+	    {"exposure", "100"},
+	    {"gain", "2"},
+	};
+};
+
+class ParameterCacheTest : public ::testing::Test {
+protected:
+	using Cache = ParameterCache<RegisterCamera>;
+
+	void SetUp() override {
+		camera      = std::make_shared<RegisterCamera>();
+		auto buffer = std::make_shared<ReadBuffer<RegisterCamera>>(camera);
+		cache       = std::make_unique<Cache>(camera, buffer);
+	}
+
+	std::shared_ptr<RegisterCamera> camera;
+	std::unique_ptr<Cache>          cache;
+};
+
+TEST_F(ParameterCacheTest, CachesRepliesUntilTheyExpire) {
+	cache->SetTTL("gain?", std::chrono::milliseconds{20});
+	cache->SetTTL("exposure?", std::chrono::milliseconds{0});
+
+	EXPECT_EQ(cache->Get("gain?"), "gain=2");
+	EXPECT_EQ(cache->Get("gain?"), "gain=2");
+	EXPECT_EQ(camera->Transactions(), 1);
+
+	EXPECT_EQ(cache->Get("exposure?"), "exposure=100");
+	EXPECT_EQ(cache->Get("exposure?"), "exposure=100");
+	EXPECT_EQ(camera->Transactions(), 3);
+
+	std::this_thread::sleep_for(std::chrono::milliseconds{30});
+	EXPECT_EQ(cache->Get("gain?"), "gain=2");
+	EXPECT_EQ(camera->Transactions(), 4);
+
+	const auto stats = cache->Stats();
+	EXPECT_EQ(stats.hits, 1);
+	EXPECT_EQ(stats.misses, 4);
+}
+
+TEST_F(ParameterCacheTest, WritesThrough) {
+	EXPECT_EQ(cache->Get("exposure?"), "exposure=100");
+
+	EXPECT_EQ(cache->Set("exposure=200", "exposure?", "exposure=200"), "OK");
+	EXPECT_EQ(cache->Get("exposure?"), "exposure=200");
+	EXPECT_EQ(camera->Transactions(), 2);
+
+	// without a value, the query is invalidated.
+	cache->Set("exposure=300", "exposure?");
+	EXPECT_EQ(cache->Get("exposure?"), "exposure=300");
+	EXPECT_EQ(camera->Transactions(), 4);
+}
+
+TEST_F(ParameterCacheTest, InvalidatesOnGenerationChange) {
+	EXPECT_EQ(cache->Get("gain?"), "gain=2");
+	camera->Flush();
+	EXPECT_EQ(cache->Get("gain?"), "gain=2");
+	EXPECT_EQ(camera->Transactions(), 2);
+
+	cache->Invalidate();
+	EXPECT_EQ(cache->Get("gain?"), "gain=2");
+	EXPECT_EQ(camera->Transactions(), 3);
+
+	auto other = std::make_shared<RegisterCamera>();
+	cache->Attach(other, std::make_shared<ReadBuffer<RegisterCamera>>(other));
+	EXPECT_EQ(cache->Get("gain?"), "gain=2");
+	EXPECT_EQ(other->Transactions(), 1);
+}
+
+TEST_F(ParameterCacheTest, CoalescesConcurrentQueries) {
+	camera->Hold();
+	std::vector<std::thread> threads;
+	std::vector<std::string> replies(4);
+	threads.push_back(std::thread{[&]() {
+		replies[0] = cache->Get("gain?");
+	}});
+	camera->WaitTransactions(1);
+	for (size_t i = 1; i < replies.size(); ++i) {
+		threads.push_back(std::thread{[&, i]() {
+			replies[i] = cache->Get("gain?");
+		}});
+	}
+	while (cache->Stats().coalesced < 3) {
+		std::this_thread::sleep_for(std::chrono::milliseconds{1});
+	}
+	camera->Release();
+	for (auto &t : threads) {
+		t.join();
+	}
+
+	EXPECT_EQ(camera->Transactions(), 1);
+	for (const auto &reply : replies) {
+		EXPECT_EQ(reply, "gain=2");
+	}
+}
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include <cpptrace/exceptions.hpp>
+
+#include <spdlog/spdlog.h>
+
+#include "buffer.hpp"
+#include "buffered_io.hpp"
+#include "details.hpp"
+#include "log.hpp"
+#include "types.hpp"
+
+namespace fort {
+namespace clserpp {
+
+struct ParameterOptions {
+	LineTermination termination = LineTermination::CR;
+	std::string     delimiter   = "\r\n>";
+	uint32_t        timeout_ms  = 1000;
+	// TTL of queries without an explicit SetTTL(). A zero TTL disables
+	// caching, duration::max() keeps replies until an invalidation.
+	std::chrono::milliseconds defaultTTL{1000};
+};
+
+struct ParameterCacheStats {
+	size_t hits = 0, misses = 0, coalesced = 0;
+};
+
+// Caches the replies of camera queries, keyed by the query command. Cached
+// replies are dropped when they expire, or when the port Generation()
+// changes, i.e. after a Flush() or a SetBaudrate(). Attach() a new port
+// after a reconnection.
+//
+// A ParameterCache is thread-safe, and owns the ReadBuffer of the port: all
+// commands must go through it. Concurrent Get() of the same query are
+// coalesced into a single transaction.
+template <typename Port> class ParameterCache {
+public:
+	using clock = std::chrono::steady_clock;
+
+	ParameterCache(
+	    std::shared_ptr<Port>             port,
+	    std::shared_ptr<ReadBuffer<Port>> buffer,
+	    const ParameterOptions           &opts = {}
+	)
+	    : d_options{opts} {
+		Attach(std::move(port), std::move(buffer));
+	}
+
+	// switches to a new port, e.g. after a reconnection. All cached replies
+	// are dropped.
+	void Attach(
+	    std::shared_ptr<Port> port, std::shared_ptr<ReadBuffer<Port>> buffer
+	) {
+		if (port == nullptr || buffer == nullptr) {
+			throw cpptrace::logic_error("cannot function without a Port");
+		}
+		std::scoped_lock lock{d_ioMutex, d_mutex};
+		d_port   = std::move(port);
+		d_buffer = std::move(buffer);
+		d_entries.clear();
+	}
+
+	void SetTTL(const std::string &query, std::chrono::milliseconds ttl) {
+		std::lock_guard<std::mutex> lock{d_mutex};
+		d_ttls[query] = ttl;
+		d_entries.erase(query);
+	}
+
+	// returns the reply to query, without its delimiter.
+	std::string Get(const std::string &query) {
+		std::unique_lock<std::mutex> lock{d_mutex};
+		if (auto cached = lookup(query); cached.has_value()) {
+			++d_stats.hits;
+			return std::move(cached.value());
+		}
+		if (auto it = d_inflight.find(query); it != d_inflight.end()) {
+			++d_stats.coalesced;
+			auto reply = it->second;
+			lock.unlock();
+			return reply.get();
+		}
+
+		++d_stats.misses;
+		std::promise<std::string> promise;
+		d_inflight.emplace(query, promise.get_future().share());
+		const auto version = d_versions[query];
+		lock.unlock();
+
+		std::string reply;
+		uint64_t    generation;
+		try {
+			std::lock_guard<std::mutex> io{d_ioMutex};
+			generation = d_port->Generation();
+			reply      = transaction(query);
+		} catch (...) {
+			lock.lock();
+			d_inflight.erase(query);
+			promise.set_exception(std::current_exception());
+			throw;
+		}
+
+		lock.lock();
+		d_inflight.erase(query);
+		// a Set() or Invalidate() happened during the transaction.
+		if (d_versions[query] == version) {
+			store(query, reply, generation);
+		}
+		promise.set_value(reply);
+		return reply;
+	}
+
+	// Sends command and returns its reply. If value is set, it becomes the
+	// cached reply of query, otherwise query is invalidated.
+	std::string Set(
+	    const std::string         &command,
+	    const std::string         &query,
+	    std::optional<std::string> value = std::nullopt
+	) {
+		std::string reply;
+		uint64_t    generation;
+		{
+			std::lock_guard<std::mutex> io{d_ioMutex};
+			reply      = transaction(command);
+			generation = d_port->Generation();
+		}
+		std::lock_guard<std::mutex> lock{d_mutex};
+		++d_versions[query];
+		if (value.has_value()) {
+			store(query, std::move(value.value()), generation);
+		} else {
+			d_entries.erase(query);
+		}
+		return reply;
+	}
+
+	void Invalidate() {
+		std::lock_guard<std::mutex> lock{d_mutex};
+		for (auto &[query, version] : d_versions) {
+			++version;
+		}
+		d_entries.clear();
+	}
+
+	void Invalidate(const std::string &query) {
+		std::lock_guard<std::mutex> lock{d_mutex};
+		++d_versions[query];
+		d_entries.erase(query);
+	}
+
+	ParameterCacheStats Stats() const {
+		std::lock_guard<std::mutex> lock{d_mutex};
+		return d_stats;
+	}
+
+private:
+	struct Entry {
+		std::string       reply;
+		uint64_t          generation;
+		clock::time_point expiry;
+	};
+
+	std::chrono::milliseconds ttl(const std::string &query) const {
+		auto it = d_ttls.find(query);
+		return it == d_ttls.end() ? d_options.defaultTTL : it->second;
+	}
+
+	std::optional<std::string> lookup(const std::string &query) {
+		auto it = d_entries.find(query);
+		if (it == d_entries.end()) {
+			return std::nullopt;
+		}
+		if (it->second.generation != d_port->Generation() ||
+		    clock::now() >= it->second.expiry) {
+			d_entries.erase(it);
+			return std::nullopt;
+		}
+		return it->second.reply;
+	}
+
+	void store(const std::string &query, std::string reply, uint64_t gen) {
+		const auto duration = ttl(query);
+		if (duration.count() <= 0) {
+			return;
+		}
+		auto expiry = clock::time_point::max();
+		if (duration != std::chrono::milliseconds::max()) {
+			expiry = clock::now() + duration;
+		}
+		d_entries[query] = {
+		    .reply      = std::move(reply),
+		    .generation = gen,
+		    .expiry     = expiry,
+		};
+	}
+
+	std::string transaction(const std::string &command) {
+		CLSERPP_DEBUG(CACHE, "parameter transaction '{}'", Escaped(command));
+		d_port->Write(
+		    Buffer{command, d_options.termination},
+		    d_options.timeout_ms
+		);
+		auto reply =
+		    d_buffer->ReadUntil(d_options.timeout_ms, d_options.delimiter);
+		reply.resize(reply.size() - d_options.delimiter.size());
+		return reply;
+	}
+
+	const ParameterOptions d_options;
+
+	// serializes transactions on the port, always taken before d_mutex.
+	std::mutex                        d_ioMutex;
+	std::shared_ptr<Port>             d_port;
+	std::shared_ptr<ReadBuffer<Port>> d_buffer;
+
+	mutable std::mutex d_mutex;
+	std::unordered_map<std::string, Entry>                     d_entries;
+	std::unordered_map<std::string, std::chrono::milliseconds> d_ttls;
+	std::unordered_map<std::string, uint64_t>                  d_versions;
+	std::unordered_map<std::string, std::shared_future<std::string>>
+	                    d_inflight;
+	ParameterCacheStats d_stats;
+};
+
+} // namespace clserpp
+} // namespace fort
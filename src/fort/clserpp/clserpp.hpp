@@ -1,7 +1,11 @@
 #pragma once
 
+#include <atomic>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <tuple>
+#include <utility>
 
 #include <cpptrace/exceptions.hpp>
 
@@ -23,6 +27,42 @@ struct ManufacturerInfo {
 	std::string version;
 };
 
+namespace details {
+inline uint32_t num_serial_ports(const Backend &backend) {
+	uint32_t res = 0;
+	call(backend, &Backend::GetNumSerialPorts, &res);
+	return res;
+}
+
+// the backend of the global port index, and the index within it.
+inline std::pair<const Backend *, uint32_t> locate_port(uint32_t index) {
+	uint32_t local = index;
+	for (const auto backend : BackendRegistry::Get().Active()) {
+		const uint32_t count = num_serial_ports(*backend);
+		if (local < count) {
+			return {backend, local};
+		}
+		local -= count;
+	}
+	throw cpptrace::out_of_range("no serial port " + std::to_string(index));
+}
+} // namespace details
+
+// Concurrency model: one reader thread and one writer thread may use a
+// Serial at the same time. Read() and Write() are guarded by two distinct
+// locks, so a response arriving never contends with a command going out.
+// Concurrent readers (or writers) are serialized, but a ReadBuffer is not
+// thread-safe and should only be used by the reader thread.
+//
+// Metadata calls take the least locking possible:
+//   - BytesAvailable() and SupportedBaudrates() take no lock; supported
+//     baudrates are queried once when the port is opened.
+//   - Flush() discards input, and takes only the read lock.
+//   - SetBaudrate() takes both locks, and therefore waits for any pending
+//     Read() or Write() to complete.
+//   - Generation() takes no lock. It changes on every Flush() or
+//     SetBaudrate(), and is unique among all opened ports, which lets
+//     caches detect any event that invalidates the link state.
 class Serial {
 
 public:
@@ -31,30 +71,48 @@ public:
 		return std::unique_ptr<Serial>(res);
 	}
 
+	// number of ports, summed over all backends.
 	static uint32_t NumSerial() {
 		uint32_t res = 0;
-		details::call(clGetNumSerialPorts, &res);
+		for (const auto backend : details::BackendRegistry::Get().Active()) {
+			res += details::num_serial_ports(*backend);
+		}
 		return res;
 	}
 
 	static std::vector<SerialDescription> GetDescriptions() {
-		const auto size = NumSerial();
-
-		std::vector<SerialDescription> res(size);
-		for (uint32_t i = 0; i < size; i++) {
-			char     buffer[DefaultBufferSize];
-			uint32_t size = DefaultBufferSize;
-			details::call(clGetSerialPortIdentifier, i, buffer, &size);
-			res[i] = {.index = i, .info = buffer};
+		std::vector<SerialDescription> res;
+		for (const auto backend : details::BackendRegistry::Get().Active()) {
+			const uint32_t count = details::num_serial_ports(*backend);
+			for (uint32_t i = 0; i < count; i++) {
+				char     buffer[DefaultBufferSize];
+				uint32_t size = DefaultBufferSize;
+				details::call(
+				    *backend,
+				    &details::Backend::GetSerialPortIdentifier,
+				    i,
+				    buffer,
+				    &size
+				);
+				res.push_back({.index = uint32_t(res.size()), .info = buffer});
+			}
 		}
 		return res;
 	}
 
+	// informations of the first backend.
 	static ManufacturerInfo GetManufacturerInfos() {
-		char     buffer[DefaultBufferSize];
-		uint32_t size = DefaultBufferSize;
-		uint32_t version;
-		details::call(clGetManufacturerInfo, buffer, &size, &version);
+		const auto &backend = *details::BackendRegistry::Get().Active().front();
+		char        buffer[DefaultBufferSize];
+		uint32_t    size = DefaultBufferSize;
+		uint32_t    version;
+		details::call(
+		    backend,
+		    &details::Backend::GetManufacturerInfo,
+		    buffer,
+		    &size,
+		    &version
+		);
 		return {
 		    .name    = buffer,
 		    .version = std::string{details::version_name(clVersion_e(version))},
@@ -62,21 +120,25 @@ public:
 	}
 
 	~Serial() {
-		clSerialClose(d_serial);
+		d_backend->SerialClose(d_serial);
 	}
 
 	void Flush() const {
-		details::call(clFlushPort, d_serial);
+		std::lock_guard<std::mutex> lock{d_readMutex};
+		details::call(*d_backend, &details::Backend::FlushPort, d_serial);
+		d_generation.store(details::next_generation());
 	}
 
 	template <typename Container>
 	void Read(Container &buf, uint32_t timeout_ms) {
-		uint32_t read = 0;
+		std::lock_guard<std::mutex> lock{d_readMutex};
+		uint32_t                    read = 0;
 		while (read < buf.size()) {
 			uint32_t size = buf.size() - read;
 			try {
 				details::call(
-				    clSerialRead,
+				    *d_backend,
+				    &details::Backend::SerialRead,
 				    d_serial,
 				    &buf[read],
 				    &size,
@@ -97,12 +159,14 @@ public:
 
 	template <typename Container>
 	void Write(const Container &buf, uint32_t timeout_ms) {
-		uint32_t written = 0;
+		std::lock_guard<std::mutex> lock{d_writeMutex};
+		uint32_t                    written = 0;
 		while (written < buf.size()) {
 			uint32_t size = buf.size() - written;
 			try {
 				details::call(
-				    clSerialWrite,
+				    *d_backend,
+				    &details::Backend::SerialWrite,
 				    d_serial,
 				    &buf[written],
 				    &size,
@@ -124,32 +188,62 @@ public:
 
 	uint32_t BytesAvailable() const {
 		uint32_t res = 0;
-		details::call(clGetNumBytesAvail, d_serial, &res);
+		details::call(
+		    *d_backend,
+		    &details::Backend::GetNumBytesAvail,
+		    d_serial,
+		    &res
+		);
 		return res;
 	}
 
-	std::vector<clBaudrate_e> SupportedBaudrates() const {
-		uint32_t baudrates = 0;
-		details::call(clGetSupportedBaudRates, d_serial, &baudrates);
-
-		std::vector<clBaudrate_e> res;
-		res.reserve(32);
-		for (int i = 0; i < 32; i++) {
-			clBaudrate_e bd = clBaudrate_e(1 << i);
-			if ((baudrates & bd) != 0) {
-				res.push_back(bd);
-			}
-		}
-		return res;
+	const std::vector<clBaudrate_e> &SupportedBaudrates() const {
+		return d_supportedBaudrates;
 	}
 
 	void SetBaudrate(clBaudrate_e bd) {
-		details::call(clSetBaudRate, d_serial, bd);
+		std::scoped_lock lock{d_writeMutex, d_readMutex};
+		details::call(
+		    *d_backend,
+		    &details::Backend::SetBaudRate,
+		    d_serial,
+		    bd
+		);
+		d_generation.store(details::next_generation());
+	}
+
+	uint64_t Generation() const {
+		return d_generation.load();
 	}
 
 private:
 	Serial(uint32_t idx) {
-		details::call(clSerialInit, idx, &d_serial);
+		uint32_t local;
+		std::tie(d_backend, local) = details::locate_port(idx);
+		details::call(
+		    *d_backend,
+		    &details::Backend::SerialInit,
+		    local,
+		    &d_serial
+		);
+		try {
+			uint32_t baudrates = 0;
+			details::call(
+			    *d_backend,
+			    &details::Backend::GetSupportedBaudRates,
+			    d_serial,
+			    &baudrates
+			);
+			for (int i = 0; i < 32; i++) {
+				clBaudrate_e bd = clBaudrate_e(1 << i);
+				if ((baudrates & bd) != 0) {
+					d_supportedBaudrates.push_back(bd);
+				}
+			}
+		} catch (...) {
+			d_backend->SerialClose(d_serial);
+			throw;
+		}
 	}
 
 	Serial(const Serial &other)            = delete;
@@ -157,13 +251,20 @@ private:
 	Serial(Serial &&other)                 = delete;
 	Serial &operator=(Serial &&other)      = delete;
 
-	void *d_serial = nullptr;
+	const details::Backend *d_backend = nullptr;
+	void                   *d_serial  = nullptr;
+
+	std::vector<clBaudrate_e> d_supportedBaudrates;
+
+	mutable std::mutex d_readMutex, d_writeMutex;
+
+	mutable std::atomic<uint64_t> d_generation{details::next_generation()};
 
 	const static uint32_t DefaultBufferSize = 300;
 };
 } // namespace clserpp
 } // namespace fort
 
-std::ostream &operator<<(std::ostream &out, clBaudrate_e e) {
+inline std::ostream &operator<<(std::ostream &out, clBaudrate_e e) {
 	return out << fort::clserpp::details::baudrate_name(e);
 }
@@ -0,0 +1,54 @@
+#include <gtest/gtest.h>
+
+#include "buffer.hpp"
+#include "command.hpp"
+
+using namespace fort::clserpp;
+
+constexpr auto identify = MakeCommand<LineTermination::CR>("id");
+constexpr auto setExposure =
+    MakeCommand<LineTermination::CRLF, uint32_t>("exposure={}");
+constexpr auto setWindow =
+    MakeCommand<LineTermination::NULLCHAR, int16_t, int16_t, double>(
+        "window {} {} gain={}"
+    );
+
+static_assert(details::count_placeholders("a={} b={}") == 2);
+static_assert(identify.CAPACITY == 3);
+static_assert(setExposure.CAPACITY == 9 + 10 + 2);
+
+TEST(Command, FormatsArgumentsInPlace) {
+	EXPECT_EQ(identify().view(), "id\r");
+	EXPECT_EQ(setExposure(0).view(), "exposure=0\r\n");
+	EXPECT_EQ(setExposure(4294967295).view(), "exposure=4294967295\r\n");
+	EXPECT_EQ(
+	    setWindow(-32768, 12, 1.5).view(),
+	    std::string_view("window -32768 12 gain=1.5\0", 26)
+	);
+}
+
+TEST(Command, MatchesBufferBytes) {
+	const auto command = setExposure(1000);
+	const auto buffer  = Buffer{"exposure=1000", LineTermination::CRLF};
+	EXPECT_EQ(
+	    std::string(command.begin(), command.end()),
+	    std::string(buffer.begin(), buffer.end())
+	);
+}
+
+TEST(Command, RejectsMalformedPatterns) {
+	EXPECT_THROW(
+	    { details::count_placeholders("exposure={"); },
+	    cpptrace::logic_error
+	);
+	EXPECT_THROW(
+	    { details::count_placeholders("exposure=}"); },
+	    cpptrace::logic_error
+	);
+	// evaluated at runtime, the mismatch throws instead of failing the
+	// compilation.
+	EXPECT_THROW(
+	    { (MakeCommand<LineTermination::CR, int>("exposure")); },
+	    cpptrace::logic_error
+	);
+}
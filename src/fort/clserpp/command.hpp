@@ -0,0 +1,181 @@
+#pragma once
+
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <limits>
+#include <string_view>
+#include <type_traits>
+
+#include <cpptrace/exceptions.hpp>
+
+#include "types.hpp"
+
+namespace fort {
+namespace clserpp {
+
+// Bytes of a command built by a CommandTemplate. It lives on the stack and
+// can be passed to any Write(), like a Buffer.
+template <size_t Capacity> class FixedBuffer {
+public:
+	constexpr size_t size() const {
+		return d_size;
+	}
+
+	constexpr static size_t capacity() {
+		return Capacity;
+	}
+
+	constexpr char &operator[](size_t i) {
+		return d_data[i];
+	}
+
+	constexpr const char &operator[](size_t i) const {
+		return d_data[i];
+	}
+
+	constexpr const char *data() const {
+		return d_data.data();
+	}
+
+	constexpr const char *begin() const {
+		return d_data.data();
+	}
+
+	constexpr const char *end() const {
+		return d_data.data() + d_size;
+	}
+
+	std::string_view view() const {
+		return {d_data.data(), d_size};
+	}
+
+private:
+	template <LineTermination, size_t, typename...>
+	friend class CommandTemplate;
+
+	std::array<char, Capacity> d_data{};
+	size_t                     d_size = 0;
+};
+
+namespace details {
+
+// counts the "{}" placeholders of pattern. Any other brace is an error,
+// which fails the compilation when evaluated in a constant expression.
+constexpr size_t count_placeholders(std::string_view pattern) {
+	size_t res = 0;
+	for (size_t i = 0; i < pattern.size(); ++i) {
+		if (pattern[i] == '}') {
+			throw cpptrace::logic_error("unmatched '}' in command pattern");
+		}
+		if (pattern[i] != '{') {
+			continue;
+		}
+		if (i + 1 >= pattern.size() || pattern[i + 1] != '}') {
+			throw cpptrace::logic_error("unmatched '{' in command pattern");
+		}
+		++res;
+		++i;
+	}
+	return res;
+}
+
+// maximal number of characters std::to_chars() produces for a T.
+template <typename T> constexpr size_t max_chars() {
+	static_assert(
+	    std::is_arithmetic_v<T> && !std::is_same_v<T, bool> &&
+	        !std::is_same_v<T, char>,
+	    "command arguments must be numbers"
+	);
+	if constexpr (std::is_integral_v<T>) {
+		// digits10 + 1 digits, and a sign.
+		return std::numeric_limits<T>::digits10 + 1 + std::is_signed_v<T>;
+	} else {
+		// sign, digits, point, and the exponent.
+		return std::numeric_limits<T>::max_digits10 + 8;
+	}
+}
+
+} // namespace details
+
+// A command with Args... numeric arguments. The pattern, its "{}" argument
+// slots and the termination are checked and laid out at compile time, and
+// commands are formatted without any allocation. A malformed pattern fails
+// the compilation of a constexpr CommandTemplate:
+//
+//   constexpr auto setExposure =
+//       MakeCommand<LineTermination::CR, uint32_t>("exposure={}");
+//   serial.Write(setExposure(1000), timeout_ms);
+template <LineTermination Termination, size_t Length, typename... Args>
+class CommandTemplate {
+public:
+	constexpr static std::string_view TERMINATION =
+	    details::termination_view(Termination);
+
+	constexpr static size_t CAPACITY = Length - 2 * sizeof...(Args) +
+	                                   (0 + ... + details::max_chars<Args>()) +
+	                                   TERMINATION.size();
+
+	constexpr CommandTemplate(const char (&pattern)[Length + 1]) {
+		if (details::count_placeholders({pattern, Length}) !=
+		    sizeof...(Args)) {
+			throw cpptrace::logic_error(
+			    "command pattern does not match its arguments"
+			);
+		}
+		for (size_t i = 0, slot = 0; i < Length; ++i) {
+			d_pattern[i] = pattern[i];
+			if (pattern[i] == '{') {
+				d_slots[slot++] = i;
+			}
+		}
+	}
+
+	FixedBuffer<CAPACITY> operator()(Args... args) const {
+		FixedBuffer<CAPACITY> res;
+		char                 *out   = res.d_data.data();
+		size_t                start = 0;
+		size_t                slot  = 0;
+
+		// unused by the templates without arguments.
+		[[maybe_unused]] const auto format = [&](auto value) {
+			out = copy(start, d_slots[slot], out);
+			// CAPACITY always fits the value.
+			const auto last = res.d_data.data() + res.d_data.size();
+			out             = std::to_chars(out, last, value).ptr;
+			start           = d_slots[slot++] + 2;
+		};
+		(format(args), ...);
+
+		out = copy(start, Length, out);
+		for (char c : TERMINATION) {
+			*out++ = c;
+		}
+		res.d_size = out - res.d_data.data();
+		return res;
+	}
+
+	constexpr std::string_view Pattern() const {
+		return {d_pattern.data(), Length};
+	}
+
+private:
+	char *copy(size_t start, size_t end, char *out) const {
+		for (size_t i = start; i < end; ++i) {
+			*out++ = d_pattern[i];
+		}
+		return out;
+	}
+
+	std::array<char, Length>            d_pattern{};
+	std::array<size_t, sizeof...(Args)> d_slots{};
+};
+
+template <LineTermination Termination, typename... Args, size_t N>
+constexpr CommandTemplate<Termination, N - 1, Args...>
+MakeCommand(const char (&pattern)[N]) {
+	return CommandTemplate<Termination, N - 1, Args...>{pattern};
+}
+
+} // namespace clserpp
+} // namespace fort
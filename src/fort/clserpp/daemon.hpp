@@ -0,0 +1,544 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cpptrace/exceptions.hpp>
+
+#include <spdlog/spdlog.h>
+
+#include "buffer.hpp"
+#include "bulk.hpp"
+#include "clser.h"
+#include "clserpp.hpp"
+#include "daemon_protocol.hpp"
+#include "exceptions.hpp"
+#include "scheduler.hpp"
+#include "shm_ring.hpp"
+
+namespace fort {
+namespace clserpp {
+
+struct DaemonOptions {
+	std::string socket = details::default_daemon_socket();
+	// per client receive ring size, must be a power of two.
+	size_t ringCapacity = size_t(1) << 20;
+	// maximal latency of the port reader.
+	uint32_t pollTimeout_ms = 20;
+	uint32_t writeTimeout_ms = 1000;
+	// initial baudrate assumed to size write chunks.
+	clBaudrate_e baudrate = CL_BAUDRATE_9600;
+	// access to the socket, and therefore to the ports.
+	mode_t socketMode = 0660;
+};
+
+// Server side of clserpp-daemon. It owns the ports, opened on the first
+// client attachment and closed after the last one detached, and serves
+// clients over a unix socket. Each port has
+// a reader thread delivering received bytes to the shared memory ring of
+// every attached client, or only to the client holding an exclusive
+// session. Writes from all clients are arbitrated by a WriteScheduler.
+template <typename Port> class DaemonServer {
+public:
+	using Opener = std::function<std::shared_ptr<Port>(uint32_t index)>;
+	using Lister = std::function<std::vector<SerialDescription>()>;
+
+	DaemonServer(Opener opener, Lister lister, const DaemonOptions &opts)
+	    : d_opener{std::move(opener)}
+	    , d_lister{std::move(lister)}
+	    , d_opts{opts} {
+		d_stop = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+		if (d_stop < 0) {
+			throw cpptrace::system_error(errno, "could not create eventfd");
+		}
+		try {
+			d_listen = details::listen_daemon(d_opts.socket, d_opts.socketMode);
+		} catch (...) {
+			::close(d_stop);
+			throw;
+		}
+	}
+
+	~DaemonServer() {
+		::close(d_listen);
+		::close(d_stop);
+		::unlink(d_opts.socket.c_str());
+	}
+
+	// Serves clients until Stop() is called.
+	void Run() {
+		SPDLOG_INFO("clserpp-daemon listening on {}", d_opts.socket);
+		while (true) {
+			pollfd fds[2] = {
+			    {.fd = d_listen, .events = POLLIN, .revents = 0},
+			    {.fd = d_stop, .events = POLLIN, .revents = 0},
+			};
+			if (::poll(fds, 2, -1) < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				throw cpptrace::system_error(errno, "could not poll");
+			}
+			if (fds[1].revents != 0) {
+				break;
+			}
+			int fd = ::accept4(d_listen, nullptr, nullptr, SOCK_CLOEXEC);
+			if (fd < 0) {
+				continue;
+			}
+			spawn(fd);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock{d_mutex};
+			for (auto &session : d_sessions) {
+				::shutdown(session.connection->socket, SHUT_RDWR);
+			}
+		}
+		for (auto &session : d_sessions) {
+			session.thread.join();
+		}
+		d_sessions.clear();
+		d_ports.clear();
+	}
+
+	// Stops Run(), may be called from any thread.
+	void Stop() {
+		uint64_t one = 1;
+		if (::write(d_stop, &one, sizeof(one)) < 0) {
+			SPDLOG_ERROR("could not stop daemon: {}", std::strerror(errno));
+		}
+	}
+
+private:
+	struct Connection {
+		Connection(int socket)
+		    : socket{socket} {}
+
+		~Connection() {
+			::close(socket);
+			if (event >= 0) {
+				::close(event);
+			}
+		}
+
+		void Deliver(const char *data, size_t size) {
+			if (ring->Write(data, size) > 0) {
+				uint64_t one = 1;
+				(void)!::write(event, &one, sizeof(one));
+			}
+		}
+
+		// may be called from another session than the one serving the
+		// connection, a SOCK_SEQPACKET message is sent atomically. It never
+		// blocks: a client not reading its socket is dropped.
+		void Notify(details::DaemonStatus status, uint32_t value) {
+			const details::DaemonResponse notification{
+			    .id     = details::DAEMON_NOTIFICATION,
+			    .status = status,
+			    .value  = value,
+			};
+			try {
+				details::send_message(
+				    socket,
+				    notification,
+				    nullptr,
+				    0,
+				    {},
+				    MSG_DONTWAIT
+				);
+			} catch (const std::exception &e) {
+				SPDLOG_WARN("dropping client: {}", e.what());
+				::shutdown(socket, SHUT_RDWR);
+			}
+		}
+
+		int                                socket;
+		int                                event = -1;
+		std::optional<details::SharedRing> ring;
+	};
+
+	class PortHandler {
+	public:
+		PortHandler(std::shared_ptr<Port> port, const DaemonOptions &opts)
+		    : d_port{port}
+		    , d_scheduler{
+		          port,
+		          opts.baudrate,
+		          std::chrono::milliseconds{20},
+		          opts.writeTimeout_ms,
+		      }
+		    , d_pollTimeout_ms{opts.pollTimeout_ms} {
+			d_reader = std::thread{[this]() { readLoop(); }};
+		}
+
+		~PortHandler() {
+			d_stopping.store(true);
+			d_reader.join();
+		}
+
+		void Attach(Connection *connection) {
+			std::lock_guard<std::mutex> lock{d_mutex};
+			d_connections.push_back(connection);
+		}
+
+		// returns the number of connections still attached.
+		size_t Detach(Connection *connection) {
+			std::lock_guard<std::mutex> lock{d_mutex};
+			d_connections.erase(
+			    std::remove(
+			        d_connections.begin(),
+			        d_connections.end(),
+			        connection
+			    ),
+			    d_connections.end()
+			);
+			if (d_owner == connection) {
+				d_owner = nullptr;
+				d_condition.notify_all();
+			}
+			return d_connections.size();
+		}
+
+		void Acquire(Connection *connection, uint32_t timeout_ms) {
+			std::unique_lock<std::mutex> lock{d_mutex};
+			waitTurn(lock, connection, timeout_ms);
+			d_owner = connection;
+		}
+
+		void Release(Connection *connection) {
+			std::lock_guard<std::mutex> lock{d_mutex};
+			if (d_owner == connection) {
+				d_owner = nullptr;
+				d_condition.notify_all();
+			}
+		}
+
+		void Write(
+		    Connection *connection,
+		    Buffer    &&data,
+		    Priority    priority,
+		    uint32_t    timeout_ms
+		) {
+			std::future<void> done;
+			{
+				std::unique_lock<std::mutex> lock{d_mutex};
+				waitTurn(lock, connection, timeout_ms);
+				done = d_scheduler.Submit(std::move(data), priority);
+			}
+			done.get();
+		}
+
+		uint32_t Baudrates() const {
+			uint32_t res = 0;
+			for (const auto bd : d_port->SupportedBaudrates()) {
+				res |= bd;
+			}
+			return res;
+		}
+
+		// only the owner of an exclusive session, if any, may change the
+		// baudrate. The other attached clients are notified.
+		void SetBaudrate(Connection *connection, clBaudrate_e baudrate) {
+			std::lock_guard<std::mutex> lock{d_mutex};
+			if (d_owner != nullptr && d_owner != connection) {
+				throw cpptrace::runtime_error(
+				    "port is acquired by another client"
+				);
+			}
+			d_port->SetBaudrate(baudrate);
+			d_scheduler.SetBaudrate(baudrate);
+			for (auto other : d_connections) {
+				if (other != connection) {
+					other->Notify(
+					    details::DaemonStatus::BAUDRATE_CHANGED,
+					    uint32_t(baudrate)
+					);
+				}
+			}
+		}
+
+	private:
+		void waitTurn(
+		    std::unique_lock<std::mutex> &lock,
+		    Connection                   *connection,
+		    uint32_t                      timeout_ms
+		) {
+			if (d_condition.wait_for(
+			        lock,
+			        std::chrono::milliseconds{timeout_ms},
+			        [&]() {
+				        return d_owner == nullptr || d_owner == connection;
+			        }
+			    ) == false) {
+				throw IOTimeout(0);
+			}
+		}
+
+		void readLoop() {
+			Buffer chunk{4096};
+			while (d_stopping.load() == false) {
+				size_t wanted = std::clamp(
+				    size_t(d_port->BytesAvailable()),
+				    size_t(1),
+				    chunk.size()
+				);
+				size_t got = wanted;
+				try {
+					details::Span<char> segment{chunk.data(), wanted};
+					d_port->Read(segment, d_pollTimeout_ms);
+				} catch (const IOTimeout &e) {
+					got = e.bytes();
+				} catch (const std::exception &e) {
+					SPDLOG_ERROR("could not read port: {}", e.what());
+					std::this_thread::sleep_for(
+					    std::chrono::milliseconds{d_pollTimeout_ms}
+					);
+					continue;
+				}
+				if (got > 0) {
+					deliver(chunk.data(), got);
+				}
+			}
+		}
+
+		void deliver(const char *data, size_t size) {
+			std::lock_guard<std::mutex> lock{d_mutex};
+			if (d_owner != nullptr) {
+				d_owner->Deliver(data, size);
+				return;
+			}
+			for (auto connection : d_connections) {
+				connection->Deliver(data, size);
+			}
+		}
+
+		std::shared_ptr<Port> d_port;
+		WriteScheduler<Port>  d_scheduler;
+		uint32_t              d_pollTimeout_ms;
+
+		std::mutex                d_mutex;
+		std::condition_variable   d_condition;
+		std::vector<Connection *> d_connections;
+		Connection               *d_owner = nullptr;
+
+		std::atomic<bool> d_stopping{false};
+		std::thread       d_reader;
+	};
+
+	struct Session {
+		std::shared_ptr<Connection> connection;
+		std::thread                 thread;
+		std::atomic<bool>           done{false};
+	};
+
+	void spawn(int fd) {
+		std::lock_guard<std::mutex> lock{d_mutex};
+		// reaps terminated sessions.
+		for (auto it = d_sessions.begin(); it != d_sessions.end();) {
+			if (it->done.load()) {
+				it->thread.join();
+				it = d_sessions.erase(it);
+			} else {
+				++it;
+			}
+		}
+
+		auto &session      = d_sessions.emplace_back();
+		session.connection = std::make_shared<Connection>(fd);
+		session.thread     = std::thread{[this, &session]() {
+			try {
+				serve(*session.connection);
+			} catch (const std::exception &e) {
+				SPDLOG_ERROR("client session failed: {}", e.what());
+			}
+			session.done.store(true);
+		}};
+	}
+
+	PortHandler *attach(Connection &connection, uint32_t index) {
+		std::lock_guard<std::mutex> lock{d_mutex};
+		auto                        it = d_ports.find(index);
+		if (it == d_ports.end()) {
+			SPDLOG_INFO("opening port {}", index);
+			it = d_ports
+			         .emplace(
+			             index,
+			             std::make_unique<PortHandler>(d_opener(index), d_opts)
+			         )
+			         .first;
+		}
+
+		connection.ring  = details::SharedRing::Create(d_opts.ringCapacity);
+		connection.event = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+		if (connection.event < 0) {
+			throw cpptrace::system_error(errno, "could not create eventfd");
+		}
+		it->second->Attach(&connection);
+		return it->second.get();
+	}
+
+	std::string list() {
+		std::string res;
+		for (const auto &desc : d_lister()) {
+			res += std::to_string(desc.index) + "\t" + desc.info + "\n";
+		}
+		return res;
+	}
+
+	// the connection is always detached before it is destroyed, otherwise
+	// the port reader could still deliver to it.
+	void serve(Connection &connection) {
+		PortHandler *port = nullptr;
+		try {
+			serveRequests(connection, port);
+		} catch (...) {
+			if (port != nullptr) {
+				detach(connection, port);
+			}
+			throw;
+		}
+		if (port != nullptr) {
+			detach(connection, port);
+		}
+	}
+
+	// the port is closed under the lock, so a new client cannot open it
+	// again before it is released.
+	void detach(Connection &connection, PortHandler *port) {
+		std::lock_guard<std::mutex> lock{d_mutex};
+		if (port->Detach(&connection) == 0) {
+			const auto it = std::find_if(
+			    d_ports.begin(),
+			    d_ports.end(),
+			    [port](const auto &p) { return p.second.get() == port; }
+			);
+			SPDLOG_INFO("closing port {}", it->first);
+			d_ports.erase(it);
+		}
+		connection.ring.reset();
+	}
+
+	void serveRequests(Connection &connection, PortHandler *&port) {
+		using details::DaemonCommand;
+		using details::DaemonStatus;
+
+		details::DaemonRequest request;
+		std::string            payload;
+		std::vector<int>       received;
+		while (details::receive_message(
+		    connection.socket,
+		    request,
+		    payload,
+		    received
+		)) {
+			for (int fd : received) {
+				::close(fd);
+			}
+
+			details::DaemonResponse response{
+			    .id     = request.id,
+			    .status = DaemonStatus::OK,
+			    .value  = 0,
+			};
+			std::string      out;
+			std::vector<int> fds;
+
+			try {
+				if (request.command == DaemonCommand::LIST) {
+					out = list();
+				} else if (request.command == DaemonCommand::ATTACH) {
+					if (port != nullptr) {
+						throw cpptrace::logic_error("already attached");
+					}
+					port = attach(connection, request.value);
+					fds.push_back(connection.ring->FileDescriptor());
+					fds.push_back(connection.event);
+				} else if (port == nullptr) {
+					throw cpptrace::logic_error("not attached to a port");
+				} else {
+					switch (request.command) {
+					case DaemonCommand::WRITE:
+						if (request.priority > uint16_t(Priority::BULK)) {
+							throw cpptrace::invalid_argument(
+							    "invalid priority " +
+							    std::to_string(request.priority)
+							);
+						}
+						port->Write(
+						    &connection,
+						    Buffer{payload},
+						    Priority(request.priority),
+						    request.timeout_ms
+						);
+						break;
+					case DaemonCommand::GET_BAUDRATES:
+						response.value = port->Baudrates();
+						break;
+					case DaemonCommand::SET_BAUDRATE:
+						port->SetBaudrate(
+						    &connection,
+						    clBaudrate_e(request.value)
+						);
+						break;
+					case DaemonCommand::ACQUIRE:
+						port->Acquire(&connection, request.timeout_ms);
+						break;
+					case DaemonCommand::RELEASE:
+						port->Release(&connection);
+						break;
+					default:
+						throw cpptrace::logic_error(
+						    "unknown command " +
+						    std::to_string(int(request.command))
+						);
+					}
+				}
+			} catch (const IOTimeout &e) {
+				response.status = DaemonStatus::TIMEOUT;
+				response.value  = e.bytes();
+			} catch (const std::exception &e) {
+				response.status = DaemonStatus::ERROR;
+				out             = e.what();
+			}
+
+			details::send_message(
+			    connection.socket,
+			    response,
+			    out.data(),
+			    out.size(),
+			    fds
+			);
+		}
+	}
+
+	Opener        d_opener;
+	Lister        d_lister;
+	DaemonOptions d_opts;
+
+	int d_listen = -1, d_stop = -1;
+
+	std::mutex                                       d_mutex;
+	std::map<uint32_t, std::unique_ptr<PortHandler>> d_ports;
+	std::list<Session>                               d_sessions;
+};
+
+} // namespace clserpp
+} // namespace fort
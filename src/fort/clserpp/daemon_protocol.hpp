@@ -0,0 +1,242 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cpptrace/exceptions.hpp>
+
+namespace fort {
+namespace clserpp {
+namespace details {
+
+// Messages exchanged between clserpp-daemon and its clients over a
+// SOCK_SEQPACKET unix socket. Each message is a fixed header followed by an
+// optional payload. Requests are tagged with an id and a client may send
+// several requests before reading the responses, which carry the same id.
+// The daemon may also send notifications on its own, with the id
+// DAEMON_NOTIFICATION.
+enum class DaemonCommand : uint16_t {
+	// payload: one "<index>\t<info>\n" line per port.
+	LIST = 1,
+	// value: port index. Response carries the receive ring and its eventfd.
+	ATTACH = 2,
+	// payload: bytes to write. On timeout, value holds the bytes written.
+	WRITE = 3,
+	// response value: bitmask of supported clBaudrate_e.
+	GET_BAUDRATES = 4,
+	// value: clBaudrate_e.
+	SET_BAUDRATE = 5,
+	// exclusive session: received bytes are only delivered to, and writes
+	// only accepted from the owner until RELEASE.
+	ACQUIRE = 6,
+	RELEASE = 7,
+};
+
+enum class DaemonStatus : int32_t {
+	OK      = 0,
+	TIMEOUT = 1,
+	// payload: error message.
+	ERROR = 2,
+	// notification, value: the new clBaudrate_e of the port.
+	BAUDRATE_CHANGED = 3,
+};
+
+struct DaemonRequest {
+	uint32_t      id;
+	DaemonCommand command;
+	uint16_t      priority;
+	uint32_t      value;
+	uint32_t      timeout_ms;
+};
+
+struct DaemonResponse {
+	uint32_t     id;
+	DaemonStatus status;
+	uint32_t     value;
+};
+
+const static uint32_t DAEMON_NOTIFICATION = 0;
+
+const static size_t DAEMON_MAX_PAYLOAD = 65536;
+
+const static size_t DAEMON_MAX_FDS = 2;
+
+inline std::string default_daemon_socket() {
+	if (const char *path = std::getenv("CLSERPP_DAEMON_SOCKET")) {
+		return path;
+	}
+	if (const char *runtime = std::getenv("XDG_RUNTIME_DIR")) {
+		return std::string(runtime) + "/clserpp.sock";
+	}
+	return "/tmp/clserpp.sock";
+}
+
+inline sockaddr_un unix_address(const std::string &path) {
+	sockaddr_un res;
+	std::memset(&res, 0, sizeof(res));
+	res.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(res.sun_path)) {
+		throw cpptrace::logic_error("socket path '" + path + "' is too long");
+	}
+	std::strncpy(res.sun_path, path.c_str(), sizeof(res.sun_path) - 1);
+	return res;
+}
+
+inline int connect_daemon(const std::string &path) {
+	const auto address = unix_address(path);
+	int        fd      = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		throw cpptrace::system_error(errno, "could not create socket");
+	}
+	if (::connect(fd, (const sockaddr *)&address, sizeof(address)) != 0) {
+		int err = errno;
+		::close(fd);
+		throw cpptrace::system_error(err, "could not connect to " + path);
+	}
+	return fd;
+}
+
+// true if a daemon accepts connections on path.
+inline bool daemon_listening(const std::string &path) {
+	const auto address = unix_address(path);
+	int        fd      = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		throw cpptrace::system_error(errno, "could not create socket");
+	}
+	const bool res =
+	    ::connect(fd, (const sockaddr *)&address, sizeof(address)) == 0;
+	::close(fd);
+	return res;
+}
+
+// A socket file left by a daemon which did not exit cleanly refuses
+// connections and is replaced, but not the one of a running daemon. The
+// socket is restricted to mode before it accepts connections.
+inline int listen_daemon(const std::string &path, mode_t mode = 0660) {
+	if (daemon_listening(path)) {
+		throw cpptrace::runtime_error(
+		    "a daemon is already listening on " + path
+		);
+	}
+	const auto address = unix_address(path);
+	int        fd      = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		throw cpptrace::system_error(errno, "could not create socket");
+	}
+	::unlink(path.c_str());
+	if (::bind(fd, (const sockaddr *)&address, sizeof(address)) != 0 ||
+	    ::chmod(path.c_str(), mode) != 0 || ::listen(fd, 16) != 0) {
+		int err = errno;
+		::close(fd);
+		throw cpptrace::system_error(err, "could not listen on " + path);
+	}
+	return fd;
+}
+
+template <typename Header>
+void send_message(
+    int                     socket,
+    const Header           &header,
+    const char             *payload = nullptr,
+    size_t                  size    = 0,
+    const std::vector<int> &fds     = {},
+    int                     flags   = 0
+) {
+	iovec iov[2] = {
+	    {.iov_base = (void *)&header, .iov_len = sizeof(Header)},
+	    {.iov_base = (void *)payload, .iov_len = size},
+	};
+	msghdr msg;
+	std::memset(&msg, 0, sizeof(msg));
+	msg.msg_iov    = iov;
+	msg.msg_iovlen = size > 0 ? 2 : 1;
+
+	alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * DAEMON_MAX_FDS)];
+	if (fds.empty() == false) {
+		if (fds.size() > DAEMON_MAX_FDS) {
+			throw cpptrace::logic_error("too many file descriptors");
+		}
+		msg.msg_control    = control;
+		msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+		cmsghdr *cmsg      = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level   = SOL_SOCKET;
+		cmsg->cmsg_type    = SCM_RIGHTS;
+		cmsg->cmsg_len     = CMSG_LEN(sizeof(int) * fds.size());
+		std::memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+	}
+
+	if (::sendmsg(socket, &msg, MSG_NOSIGNAL | flags) < 0) {
+		throw cpptrace::system_error(errno, "could not send message");
+	}
+}
+
+// Receives a message. Returns false when the peer closed the connection.
+// Received file descriptors are owned by the caller.
+template <typename Header>
+bool receive_message(
+    int               socket,
+    Header           &header,
+    std::string      &payload,
+    std::vector<int> &fds
+) {
+	payload.resize(DAEMON_MAX_PAYLOAD);
+	iovec iov[2] = {
+	    {.iov_base = &header, .iov_len = sizeof(Header)},
+	    {.iov_base = payload.data(), .iov_len = payload.size()},
+	};
+	alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * DAEMON_MAX_FDS)];
+	msghdr                msg;
+	std::memset(&msg, 0, sizeof(msg));
+	msg.msg_iov        = iov;
+	msg.msg_iovlen     = 2;
+	msg.msg_control    = control;
+	msg.msg_controllen = sizeof(control);
+
+	ssize_t size;
+	do {
+		size = ::recvmsg(socket, &msg, MSG_CMSG_CLOEXEC);
+	} while (size < 0 && errno == EINTR);
+	if (size < 0) {
+		throw cpptrace::system_error(errno, "could not receive message");
+	}
+	if (size == 0) {
+		return false;
+	}
+
+	fds.clear();
+	for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+	     cmsg          = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+			continue;
+		}
+		const size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		fds.resize(fds.size() + count);
+		std::memcpy(
+		    fds.data() + fds.size() - count,
+		    CMSG_DATA(cmsg),
+		    count * sizeof(int)
+		);
+	}
+
+	if (size_t(size) < sizeof(Header) || (msg.msg_flags & MSG_TRUNC) != 0) {
+		for (int fd : fds) {
+			::close(fd);
+		}
+		throw cpptrace::runtime_error("malformed daemon message");
+	}
+	payload.resize(size - sizeof(Header));
+	return true;
+}
+
+} // namespace details
+} // namespace clserpp
+} // namespace fort
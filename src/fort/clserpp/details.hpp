@@ -2,10 +2,14 @@
 
 #include "clser.h"
 
+#include "backend.hpp"
+#include "escape.hpp"
+#include "exceptions.hpp"
 #include "types.hpp"
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cpptrace/exceptions.hpp>
 #include <optional>
 #include <string>
@@ -17,43 +21,41 @@ namespace fort {
 namespace clserpp {
 namespace details {
 
-class clserException : public cpptrace::runtime_error {
-
+// A driver error. It only holds the error code, the message is formatted on
+// the first what() for the whole process.
+class clserException : public Error {
 public:
-	clserException(int32_t code) noexcept
-	    : cpptrace::runtime_error(
-	          "clser error (" + std::to_string(code) +
-	          "): " + getErrorText(code)
-	      )
-	    , d_code{code} {}
+	clserException(int32_t code, const Backend &backend) noexcept
+	    : d_code{code}
+	    , d_backend{&backend} {}
+
+	const char *what() const noexcept override {
+		return d_backend->ErrorMessage(d_code);
+	}
 
 	int32_t code() const noexcept {
 		return d_code;
 	}
 
 private:
-	std::string getErrorText(int32_t code) {
-		char     buffer[2000];
-		uint32_t size     = 2000;
-		int32_t  errorRes = clGetErrorText(code, buffer, &size);
-		if (errorRes != 0) {
-			return "could not get error text: error " +
-			       std::to_string(errorRes);
-		}
-		return buffer;
-	}
-
-	int32_t d_code;
+	int32_t        d_code;
+	const Backend *d_backend;
 };
 
 template <typename Fnct, typename... Args>
-void call(Fnct &&fnct, Args &&...args) {
-	int32_t res = std::forward<Fnct>(fnct)(std::forward<Args>(args)...);
+void call(const Backend &backend, Fnct Backend::*fnct, Args &&...args) {
+	int32_t res = (backend.*fnct)(std::forward<Args>(args)...);
 	if (res != 0) {
-		throw clserException(res);
+		throw clserException(res, backend);
 	}
 }
 
+// process wide source of link generations, see Serial::Generation().
+inline uint64_t next_generation() {
+	static std::atomic<uint64_t> generation{0};
+	return ++generation;
+}
+
 inline const char *version_name(clVersion_e e) {
 	switch (e) {
 	case CL_VERSION_NONE:
@@ -72,7 +74,7 @@ inline const char *version_name(clVersion_e e) {
 inline const char *baudrate_name(clBaudrate_e e) {
 	switch (e) {
 	case CL_BAUDRATE_9600:
-		return " CL_BAUDRATE_9600";
+		return "CL_BAUDRATE_9600";
 	case CL_BAUDRATE_19200:
 		return "CL_BAUDRATE_19200";
 	case CL_BAUDRATE_38400:
@@ -94,6 +96,31 @@ inline const char *baudrate_name(clBaudrate_e e) {
 	}
 }
 
+inline uint32_t baudrate_value(clBaudrate_e e) {
+	switch (e) {
+	case CL_BAUDRATE_9600:
+		return 9600;
+	case CL_BAUDRATE_19200:
+		return 19200;
+	case CL_BAUDRATE_38400:
+		return 38400;
+	case CL_BAUDRATE_57600:
+		return 57600;
+	case CL_BAUDRATE_115200:
+		return 115200;
+	case CL_BAUDRATE_230400:
+		return 230400;
+	case CL_BAUDRATE_460800:
+		return 460800;
+	case CL_BAUDRATE_921600:
+		return 921600;
+	default:
+		throw cpptrace::out_of_range(
+		    "Unknown baudrate value " + std::to_string(int(e))
+		);
+	}
+}
+
 inline std::optional<clBaudrate_e> baudrate_cast(const std::string &bd) {
 	if (bd == "CL_BAUDRATE_9600") {
 		return CL_BAUDRATE_9600;
@@ -141,80 +168,15 @@ inline std::optional<LineTermination> termination_cast(const std::string &s) {
 	return std::nullopt;
 }
 
-inline const char *escape_char(char c) {
-	struct EscapableChar {
-	public:
-		char        value;
-		const char *escaped;
-	};
-
-	const static std::array<EscapableChar, 4> escapables = {
-	    EscapableChar{.value = '\r', .escaped = "\\r"},
-	    EscapableChar{.value = '\n', .escaped = "\\n"},
-	    EscapableChar{.value = '\\', .escaped = R"(\)"},
-	    EscapableChar{.value = '\t', .escaped = "\\t"},
-	};
-
-	auto pos = std::find_if(
-	    escapables.begin(),
-	    escapables.end(),
-	    [v = c](const EscapableChar &c) { return c.value == v; }
-	);
-
-	if (pos != escapables.end()) {
-		return pos->escaped;
-	}
-	return nullptr;
-}
-
 inline std::string escape(const std::string &s) {
 	std::string res;
-	res.reserve(s.size() * 2);
-	for (const auto c : s) {
-		auto escaped = fort::clserpp::details::escape_char(c);
-		if (escaped == nullptr) {
-			res.push_back(c);
-			continue;
-		}
-		for (const auto cc : std::string(escaped)) {
-			res.push_back(cc);
-		}
-	}
+	AppendEscaped(res, s);
 	return res;
 }
 
 inline std::string parse_ascii(const std::string &str) {
 	std::string res;
-	res.reserve(str.size());
-	for (auto it = str.begin(); it != str.end(); ++it) {
-		auto found = std::find(it, str.end(), '\\');
-		res.insert(res.end(), it, found);
-		if (found == str.end()) {
-			break;
-		}
-		if (found == str.end() - 1) {
-			res.push_back('\\');
-			break;
-		}
-
-		it = found + 1;
-		std::cerr << "got: " << *it << std::endl;
-		switch (*(found + 1)) {
-		case 'n':
-			res.push_back('\n');
-			break;
-		case 'r':
-			res.push_back('\r');
-			break;
-		case 't':
-			res.push_back('\t');
-			break;
-		default:
-			res.push_back('\\');
-			--it;
-			break;
-		}
-	}
+	AppendUnescaped(res, str);
 	return res;
 }
 
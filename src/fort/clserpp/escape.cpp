@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+
+#include <random>
+#include <string>
+
+#include "escape.hpp"
+
+using namespace fort::clserpp;
+
+std::string escape(std::string_view in) {
+	std::string res;
+	AppendEscaped(res, in);
+	return res;
+}
+
+std::string unescape(std::string_view in) {
+	std::string res;
+	AppendUnescaped(res, in);
+	return res;
+}
+
+TEST(Escape, EscapesSpecialBytes) {
+	EXPECT_EQ(escape("id\r\n"), "id\\r\\n");
+	EXPECT_EQ(escape("a\\b"), "a\\\\b");
+	EXPECT_EQ(escape("\a\b\t\n\v\f\r"), "\\a\\b\\t\\n\\v\\f\\r");
+	EXPECT_EQ(escape(std::string_view{"\0\x7f\xaf", 3}), "\\x00\\x7f\\xaf");
+	EXPECT_EQ(escape("\"quoted\" 'text'?"), "\"quoted\" 'text'?");
+	EXPECT_EQ(escape(""), "");
+}
+
+TEST(Escape, UnescapesTheCEscapeSet) {
+	EXPECT_EQ(unescape("\\a\\b\\t\\n\\v\\f\\r"), "\a\b\t\n\v\f\r");
+	EXPECT_EQ(unescape("\\\\\\\"\\'\\?"), "\\\"'?");
+	EXPECT_EQ(unescape("\\0"), std::string(1, '\0'));
+	EXPECT_EQ(unescape("\\101\\1012"), "AA2");
+	EXPECT_EQ(unescape("\\x41\\x4a\\xA"), "AJ\n");
+	EXPECT_EQ(unescape("\\x414"), "A4");
+	// unknown or incomplete sequences are kept.
+	EXPECT_EQ(unescape("\\q\\x\\"), "\\q\\x\\");
+}
+
+TEST(Escape, RoundTripsBinaryData) {
+	std::string all;
+	for (int i = 0; i < 256; ++i) {
+		all.push_back(char(i));
+	}
+	EXPECT_EQ(unescape(escape(all)), all);
+
+	std::mt19937                       rng{42};
+	std::uniform_int_distribution<int> byte{0, 255}, special{0, 9};
+	for (size_t size = 0; size < 100; ++size) {
+		std::string data;
+		for (size_t i = 0; i < size; ++i) {
+			// mostly printable, to exercise the bulk copies.
+			data.push_back(special(rng) == 0 ? char(byte(rng)) : 'a' + i % 26);
+		}
+		EXPECT_EQ(unescape(escape(data)), data) << "size: " << size;
+	}
+}
+
+TEST(Escape, UnescapesStreams) {
+	const std::string escaped = escape(std::string_view{"x\0y\r\n\xff", 6});
+
+	for (size_t chunk = 1; chunk < 8; ++chunk) {
+		std::string pending, res;
+		for (size_t i = 0; i < escaped.size(); i += chunk) {
+			pending += escaped.substr(i, chunk);
+			const bool last = i + chunk >= escaped.size();
+			const auto size = res.size();
+			res.resize(size + pending.size());
+			const auto r = Unescape(pending, res.data() + size, last);
+			res.resize(size + r.written);
+			pending.erase(0, r.read);
+		}
+		EXPECT_EQ(res, std::string("x\0y\r\n\xff", 6)) << "chunk: " << chunk;
+		EXPECT_TRUE(pending.empty());
+	}
+}
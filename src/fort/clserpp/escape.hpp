@@ -0,0 +1,292 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace fort {
+namespace clserpp {
+
+// Escape codec for strings holding binary data. Printable ASCII characters
+// are kept, the backslash and C control characters use the C escapes
+// (\a \b \t \n \v \f \r \\), and any other byte is written "\xNN" with two
+// lowercase hexadecimal digits.
+//
+// Unescaping accepts the full C escape set: the above, \" \' \?, octal
+// \o, \oo or \ooo (i.e. \0), and \xN or \xNN. Unknown or incomplete
+// sequences are kept verbatim.
+
+// maximal size of the escape of size bytes.
+constexpr size_t EscapedSizeMax(size_t size) {
+	return 4 * size;
+}
+
+namespace details {
+
+struct EscapeSequence {
+	uint8_t size = 0;
+	char    text[4]{};
+};
+
+constexpr std::array<EscapeSequence, 256> make_escape_sequences() {
+	constexpr std::string_view hex = "0123456789abcdef";
+
+	std::array<EscapeSequence, 256> res{};
+	for (int i = 0; i < 256; ++i) {
+		auto &s = res[i];
+		if (i >= 0x20 && i < 0x7f && i != '\\') {
+			s.text[s.size++] = char(i);
+			continue;
+		}
+		s.text[s.size++] = '\\';
+		switch (i) {
+		case '\a':
+			s.text[s.size++] = 'a';
+			continue;
+		case '\b':
+			s.text[s.size++] = 'b';
+			continue;
+		case '\t':
+			s.text[s.size++] = 't';
+			continue;
+		case '\n':
+			s.text[s.size++] = 'n';
+			continue;
+		case '\v':
+			s.text[s.size++] = 'v';
+			continue;
+		case '\f':
+			s.text[s.size++] = 'f';
+			continue;
+		case '\r':
+			s.text[s.size++] = 'r';
+			continue;
+		case '\\':
+			s.text[s.size++] = '\\';
+			continue;
+		}
+		s.text[s.size++] = 'x';
+		s.text[s.size++] = hex[i >> 4];
+		s.text[s.size++] = hex[i & 0xf];
+	}
+	return res;
+}
+
+inline constexpr auto escape_sequences = make_escape_sequences();
+
+constexpr bool needs_escape(char c) {
+	return escape_sequences[uint8_t(c)].size != 1;
+}
+
+// position of the first byte of [begin, end[ matching Match, or end.
+template <typename Match, typename Mask>
+const char *
+scan(const char *begin, const char *end, Match &&match, Mask &&mask) {
+#if defined(__SSE2__)
+	for (; end - begin >= 16; begin += 16) {
+		const __m128i chunk = _mm_loadu_si128((const __m128i *)begin);
+		if (const int bits = _mm_movemask_epi8(mask(chunk)); bits != 0) {
+			return begin + __builtin_ctz(bits);
+		}
+	}
+#endif
+	for (; begin != end && match(*begin) == false; ++begin) {
+	}
+	return begin;
+}
+
+// first byte needing an escape.
+inline const char *find_escape(const char *begin, const char *end) {
+	return scan(
+	    begin,
+	    end,
+	    [](char c) { return needs_escape(c); },
+	    [](auto chunk) {
+#if defined(__SSE2__)
+		    // bytes from 0x80 are negative as signed chars.
+		    const __m128i control = _mm_cmplt_epi8(chunk, _mm_set1_epi8(0x20));
+		    const __m128i del     = _mm_cmpeq_epi8(chunk, _mm_set1_epi8(0x7f));
+		    const __m128i slash   = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\'));
+		    return _mm_or_si128(control, _mm_or_si128(del, slash));
+#else
+		    return chunk;
+#endif
+	    }
+	);
+}
+
+inline const char *find_backslash(const char *begin, const char *end) {
+	return scan(
+	    begin,
+	    end,
+	    [](char c) { return c == '\\'; },
+	    [](auto chunk) {
+#if defined(__SSE2__)
+		    return _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\'));
+#else
+		    return chunk;
+#endif
+	    }
+	);
+}
+
+constexpr int hex_value(char c) {
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	}
+	if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	}
+	if (c >= 'A' && c <= 'F') {
+		return c - 'A' + 10;
+	}
+	return -1;
+}
+
+constexpr bool is_octal(char c) {
+	return c >= '0' && c <= '7';
+}
+
+} // namespace details
+
+// Escapes in to out, which must hold EscapedSizeMax(in.size()) bytes.
+// Returns the number of bytes written.
+inline size_t Escape(std::string_view in, char *out) {
+	char       *start = out;
+	const char *it    = in.data();
+	const char *end   = in.data() + in.size();
+	while (it != end) {
+		const char *special = details::find_escape(it, end);
+		std::memcpy(out, it, special - it);
+		out += special - it;
+		it = special;
+		for (; it != end && details::needs_escape(*it); ++it) {
+			const auto &s = details::escape_sequences[uint8_t(*it)];
+			std::memcpy(out, s.text, 4);
+			out += s.size;
+		}
+	}
+	return out - start;
+}
+
+struct UnescapeResult {
+	size_t read, written;
+};
+
+// Unescapes in to out, which must hold in.size() bytes. Unless last is set,
+// an escape sequence that may continue after in is left unread, so a
+// stream can be decoded chunk by chunk.
+inline UnescapeResult
+Unescape(std::string_view in, char *out, bool last = true) {
+	char       *start = out;
+	const char *it    = in.data();
+	const char *end   = in.data() + in.size();
+	while (it != end) {
+		const char *slash = details::find_backslash(it, end);
+		std::memcpy(out, it, slash - it);
+		out += slash - it;
+		it = slash;
+		if (it == end) {
+			break;
+		}
+
+		// longest sequence is \ooo.
+		if (last == false && end - it < 4) {
+			break;
+		}
+		const char *next = it + 1;
+		if (next == end) {
+			*out++ = *it++;
+			continue;
+		}
+
+		char value = 0;
+		switch (*next) {
+		case 'a':
+			value = '\a';
+			break;
+		case 'b':
+			value = '\b';
+			break;
+		case 't':
+			value = '\t';
+			break;
+		case 'n':
+			value = '\n';
+			break;
+		case 'v':
+			value = '\v';
+			break;
+		case 'f':
+			value = '\f';
+			break;
+		case 'r':
+			value = '\r';
+			break;
+		case '\\':
+		case '"':
+		case '\'':
+		case '?':
+			value = *next;
+			break;
+		case 'x': {
+			int digits = 0, v = 0;
+			for (; digits < 2 && next + 1 + digits != end; ++digits) {
+				const int d = details::hex_value(next[1 + digits]);
+				if (d < 0) {
+					break;
+				}
+				v = v * 16 + d;
+			}
+			if (digits == 0) {
+				*out++ = *it++;
+				continue;
+			}
+			*out++ = char(v);
+			it     = next + 1 + digits;
+			continue;
+		}
+		default:
+			if (details::is_octal(*next)) {
+				int digits = 0, v = 0;
+				for (; digits < 3 && next + digits != end &&
+				       details::is_octal(next[digits]);
+				     ++digits) {
+					v = v * 8 + (next[digits] - '0');
+				}
+				*out++ = char(v);
+				it     = next + digits;
+				continue;
+			}
+			*out++ = *it++;
+			continue;
+		}
+		*out++ = value;
+		it     = next + 1;
+	}
+	return {.read = size_t(it - in.data()), .written = size_t(out - start)};
+}
+
+// Appends the escape of in to out, a std::string or a fmt::memory_buffer.
+template <typename Container>
+void AppendEscaped(Container &out, std::string_view in) {
+	const size_t size = out.size();
+	out.resize(size + EscapedSizeMax(in.size()));
+	out.resize(size + Escape(in, out.data() + size));
+}
+
+template <typename Container>
+void AppendUnescaped(Container &out, std::string_view in) {
+	const size_t size = out.size();
+	out.resize(size + in.size());
+	out.resize(size + Unescape(in, out.data() + size).written);
+}
+
+} // namespace clserpp
+} // namespace fort
@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "details.hpp"
+#include "exceptions.hpp"
+
+using namespace fort::clserpp;
+
+TEST(Exceptions, FormatsTimeouts) {
+	EXPECT_STREQ(IOTimeout(0).what(), "timouted after 0 bytes");
+	EXPECT_STREQ(
+	    IOTimeout(4294967295).what(),
+	    "timouted after 4294967295 bytes"
+	);
+	EXPECT_EQ(IOTimeout(12).bytes(), 12);
+
+	IOTimeout copy = IOTimeout(42);
+	EXPECT_STREQ(copy.what(), "timouted after 42 bytes");
+}
+
+static std::atomic<int> errorTexts{0};
+
+static int32_t errorText(int32_t code, char *buffer, uint32_t *size) {
+	++errorTexts;
+	std::snprintf(buffer, *size, "error %d", int(code));
+	return 0;
+}
+
+TEST(Exceptions, CachesErrorTexts) {
+	details::Backend backend;
+	backend.GetErrorText = &errorText;
+
+	const details::clserException a{-10004, backend}, b{-10004, backend},
+	    c{-10001, backend};
+	EXPECT_EQ(errorTexts, 0);
+	EXPECT_STREQ(a.what(), "clser error (-10004): error -10004");
+	EXPECT_EQ(a.what(), b.what());
+	EXPECT_NE(a.what(), c.what());
+	EXPECT_EQ(c.code(), -10001);
+	EXPECT_EQ(errorTexts, 2);
+
+	std::vector<std::thread>  threads;
+	std::vector<const char *> messages(8);
+	for (size_t i = 0; i < messages.size(); ++i) {
+		threads.emplace_back([&messages, &backend, i]() {
+			messages[i] = details::clserException(-10010, backend).what();
+		});
+	}
+	for (auto &t : threads) {
+		t.join();
+	}
+	for (const auto m : messages) {
+		EXPECT_EQ(m, messages.front());
+	}
+}
+
+TEST(Exceptions, CapturesTracesOnDemand) {
+	EXPECT_TRUE(IOTimeout(0).trace().empty());
+	SetErrorTraces(true);
+	// the trace may still be empty when cpptrace has no unwinder.
+	EXPECT_NO_THROW({ IOTimeout(0).trace(); });
+	SetErrorTraces(false);
+}
+
+TEST(Exceptions, AreCpptraceExceptions) {
+	static_assert(std::is_nothrow_constructible_v<IOTimeout, uint32_t>);
+
+	details::Backend backend;
+	backend.GetErrorText = &errorText;
+	try {
+		throw details::clserException(-10004, backend);
+	} catch (const cpptrace::exception &e) {
+		EXPECT_STREQ(e.what(), "clser error (-10004): error -10004");
+	}
+	try {
+		throw IOTimeout(3);
+	} catch (const cpptrace::exception &e) {
+		EXPECT_STREQ(e.what(), "timouted after 3 bytes");
+	}
+}
@@ -1,15 +1,85 @@
 #pragma once
 
-#include <cpptrace/exceptions.hpp>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <string_view>
+
+#include <cpptrace/cpptrace.hpp>
 
 namespace fort {
 namespace clserpp {
-class IOTimeout : public cpptrace::runtime_error {
+
+namespace details {
+inline std::atomic<bool> &error_traces() {
+	static std::atomic<bool> enabled{false};
+	return enabled;
+}
+} // namespace details
+
+// Enables the capture of a stack trace by the library errors, i.e. IOTimeout.
+// Only the return addresses are captured when thrown, they are resolved by
+// Error::trace(). Off by default, as some links report transient errors very
+// often.
+inline void SetErrorTraces(bool enabled) {
+	details::error_traces().store(enabled, std::memory_order_relaxed);
+}
+
+// Base of the library errors, cheap to construct. It is a cpptrace::exception,
+// but unlike the cpptrace errors, it does not capture a trace unless
+// SetErrorTraces() is enabled.
+class Error : public cpptrace::exception {
+public:
+	Error() noexcept {
+		if (details::error_traces().load(std::memory_order_relaxed)) {
+			try {
+				d_trace = cpptrace::raw_trace::current(1);
+			} catch (...) {
+			}
+		}
+	}
+
+	const char *message() const noexcept {
+		return what();
+	}
+
+	// stack trace of the throw site, resolved on first use, empty if traces
+	// are disabled.
+	const cpptrace::stacktrace &trace() const noexcept {
+		if (d_resolved.has_value() == false) {
+			try {
+				d_resolved = d_trace.resolve();
+			} catch (...) {
+				d_resolved.emplace();
+			}
+		}
+		return d_resolved.value();
+	}
+
+private:
+	cpptrace::raw_trace                         d_trace;
+	mutable std::optional<cpptrace::stacktrace> d_resolved;
+};
+
+class IOTimeout : public Error {
 public:
 	IOTimeout(uint32_t bytes) noexcept
-	    : cpptrace::
-	          runtime_error{"timouted after " + std::to_string(bytes) + " bytes"}
-	    , d_bytes{bytes} {}
+	    : d_bytes{bytes} {
+		constexpr std::string_view prefix = "timouted after ";
+		constexpr std::string_view suffix = " bytes";
+
+		char *it = std::copy(prefix.begin(), prefix.end(), d_what);
+		it       = std::to_chars(it, it + 10, bytes).ptr;
+		it       = std::copy(suffix.begin(), suffix.end(), it);
+		*it      = 0;
+	}
+
+	const char *what() const noexcept override {
+		return d_what;
+	}
 
 	uint32_t bytes() const noexcept {
 		return d_bytes;
@@ -17,6 +87,7 @@ public:
 
 private:
 	uint32_t d_bytes;
+	char     d_what[32];
 };
 
 } // namespace clserpp
@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+#include "buffer.hpp"
+#include "hexdump.hpp"
+
+using namespace fort::clserpp;
+
+// the escape of a single byte, independent of the escape codec.
+std::string referenceEscape(char c) {
+	switch (c) {
+	case '\a':
+		return "\\a";
+	case '\b':
+		return "\\b";
+	case '\t':
+		return "\\t";
+	case '\n':
+		return "\\n";
+	case '\v':
+		return "\\v";
+	case '\f':
+		return "\\f";
+	case '\r':
+		return "\\r";
+	case '\\':
+		return "\\\\";
+	}
+	if (c >= 0x20 && c < 0x7f) {
+		return std::string(1, c);
+	}
+	std::ostringstream out;
+	out << "\\x" << std::hex << std::setw(2) << std::setfill('0')
+	    << (int)(c & 0xff);
+	return out.str();
+}
+
+// the layout of the std::ostream based formatting the hexdump replaced.
+// Its ASCII column wrote decimal escapes, e.g. "\x0\x175", and left '\'
+// alone; since the escape codec it is escaped one byte at a time as
+// "\x00\xaf" and "\\".
+std::string referenceHexdump(const Buffer &buf) {
+	std::ostringstream out;
+	out << "buffer " << buf.size() << " bytes:" << std::endl;
+	for (auto current = buf.cbegin(); current != buf.cend();) {
+		auto linestart = current;
+		out << std::right << std::dec << std::setw(4) << std::setfill('0')
+		    << std::distance(buf.cbegin(), current) << " | ";
+		for (int group = 0; group < 4; ++group) {
+			const auto start = current;
+			const auto end   = std::min(buf.cend(), current + 4);
+			for (; current != end; ++current) {
+				out << std::hex << std::setw(2) << (int)(*current & 0xff);
+			}
+			for (int rem = 4 - std::distance(start, end); rem > 0; --rem) {
+				out << "  ";
+			}
+			out << (group == 1 ? " . " : (group == 3 ? " | " : " "));
+		}
+		for (auto it = linestart; it != current; ++it) {
+			out << referenceEscape(*it);
+		}
+		out << std::endl;
+	}
+	return out.str();
+}
+
+Buffer allBytes(size_t size) {
+	Buffer res(size);
+	for (size_t i = 0; i < size; ++i) {
+		res[i] = char(i * 7);
+	}
+	return res;
+}
+
+TEST(Hexdump, MatchesStreamFormatting) {
+	for (size_t size : {0, 1, 15, 16, 17, 256, 20011}) {
+		const auto buf = allBytes(size);
+
+		std::ostringstream out;
+		out << buf;
+		EXPECT_EQ(out.str(), referenceHexdump(buf)) << "size: " << size;
+		EXPECT_EQ(fmt::format("{}", buf), out.str()) << "size: " << size;
+	}
+}
+
+TEST(Hexdump, EscapesASCIIColumn) {
+	EXPECT_EQ(referenceEscape('\x01'), "\\x01");
+	EXPECT_EQ(referenceEscape('\xfe'), "\\xfe");
+
+	const std::string_view data{"a\x01\x7f\\\r\xa0"};
+	const auto             dump = fmt::format("{}", Hexdump(data));
+	EXPECT_NE(dump.find("| a\\x01\\x7f\\\\\\r\\xa0\n"), std::string::npos)
+	    << dump;
+}
+
+TEST(Hexdump, FormatsViews) {
+	const std::string_view data{"\x01\x02hello\r\n"};
+	const Buffer           buf{std::string(data)};
+
+	fmt::memory_buffer out;
+	FormatHexdump(out, data.data(), data.size());
+	EXPECT_EQ(fmt::to_string(out), fmt::format("{}", buf));
+	EXPECT_EQ(fmt::format("{}", Hexdump(data)), fmt::format("{}", buf));
+}
+
+TEST(Hexdump, Streams) {
+	const auto buf = allBytes(1000);
+
+	std::string streamed;
+	size_t      flushes = 0;
+	const auto  sink    = [&](std::string_view lines) {
+		streamed += lines;
+		++flushes;
+	};
+	Hexdumper dumper{sink, 1024};
+	for (size_t offset = 0; offset < buf.size();) {
+		const size_t size = std::min(buf.size() - offset, offset % 37 + 1);
+		dumper.Write(buf.data() + offset, size);
+		offset += size;
+	}
+	dumper.Finish();
+
+	const auto expected = fmt::format("{}", buf);
+	EXPECT_EQ(streamed, expected.substr(expected.find('\n') + 1));
+	EXPECT_EQ(dumper.Offset(), buf.size());
+	EXPECT_GT(flushes, 1);
+}
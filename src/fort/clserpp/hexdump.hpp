@@ -0,0 +1,186 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <string_view>
+
+#include <spdlog/fmt/fmt.h>
+
+#include "escape.hpp"
+
+namespace fort {
+namespace clserpp {
+
+namespace details {
+
+inline constexpr std::string_view hex_digits = "0123456789abcdef";
+
+// offset, separators, 16 hexadecimal bytes and their escapes.
+const static size_t HEXDUMP_LINE_MAX = 20 + 3 + 32 + 8 + 16 * 4 + 1;
+
+// formats the line of at most 16 bytes found at offset.
+template <typename OutputIt>
+OutputIt
+hexdump_line(OutputIt out, size_t offset, const char *data, size_t size) {
+	constexpr std::string_view separators[4] = {" ", " . ", " ", " | "};
+
+	std::array<char, HEXDUMP_LINE_MAX> line;
+
+	char *it = line.data();
+	char  digits[20];
+	auto  end = std::to_chars(digits, digits + sizeof(digits), offset).ptr;
+	for (auto n = end - digits; n < 4; ++n) {
+		*it++ = '0';
+	}
+	it    = std::copy(digits, end, it);
+	*it++ = ' ';
+	*it++ = '|';
+	*it++ = ' ';
+
+	for (size_t i = 0; i < 16; ++i) {
+		if (i < size) {
+			const auto c = uint8_t(data[i]);
+			*it++        = hex_digits[c >> 4];
+			*it++        = hex_digits[c & 0xf];
+		} else {
+			*it++ = ' ';
+			*it++ = ' ';
+		}
+		if (i % 4 == 3) {
+			const auto &sep = separators[i / 4];
+			it              = std::copy(sep.begin(), sep.end(), it);
+		}
+	}
+
+	it += Escape({data, size}, it);
+	*it++ = '\n';
+
+	return std::copy(line.data(), it, out);
+}
+
+// formats data as operator<<(std::ostream &, const Buffer &) does.
+template <typename OutputIt>
+OutputIt hexdump(OutputIt out, const char *data, size_t size) {
+	out = fmt::format_to(out, "buffer {} bytes:\n", size);
+	for (size_t offset = 0; offset < size; offset += 16) {
+		out = hexdump_line(
+		    out,
+		    offset,
+		    data + offset,
+		    std::min(size_t(16), size - offset)
+		);
+	}
+	return out;
+}
+
+} // namespace details
+
+// Lazily formatted hexdump of bytes it does not own, for instance
+// SPDLOG_DEBUG("{}", Hexdump(view)).
+struct HexdumpView {
+	const char *data;
+	size_t      size;
+};
+
+inline HexdumpView Hexdump(const char *data, size_t size) {
+	return {.data = data, .size = size};
+}
+
+template <typename Range> HexdumpView Hexdump(const Range &bytes) {
+	return Hexdump(std::data(bytes), std::size(bytes));
+}
+
+inline void
+FormatHexdump(fmt::memory_buffer &out, const char *data, size_t size) {
+	details::hexdump(fmt::appender(out), data, size);
+}
+
+// Hexdump of a stream of bytes, for captures too large to be formatted at
+// once. Formatted lines are handed over to the sink by blocks of about
+// flushSize bytes. There is no header, and Finish() must be called to
+// format the last bytes.
+class Hexdumper {
+public:
+	using Sink = std::function<void(std::string_view)>;
+
+	Hexdumper(Sink sink, size_t flushSize = 64 * 1024)
+	    : d_sink{std::move(sink)}
+	    , d_flushSize{flushSize} {}
+
+	void Write(const char *data, size_t size) {
+		if (d_lineSize > 0) {
+			const size_t n = std::min(size, 16 - d_lineSize);
+			std::copy(data, data + n, d_line.begin() + d_lineSize);
+			d_lineSize += n;
+			data += n;
+			size -= n;
+			if (d_lineSize < 16) {
+				return;
+			}
+			appendLine(d_line.data(), 16);
+			d_lineSize = 0;
+		}
+		for (; size >= 16; data += 16, size -= 16) {
+			appendLine(data, 16);
+		}
+		std::copy(data, data + size, d_line.begin());
+		d_lineSize = size;
+	}
+
+	void Finish() {
+		if (d_lineSize > 0) {
+			appendLine(d_line.data(), d_lineSize);
+			d_lineSize = 0;
+		}
+		flush();
+	}
+
+	// number of bytes written so far.
+	size_t Offset() const {
+		return d_offset + d_lineSize;
+	}
+
+private:
+	void appendLine(const char *data, size_t size) {
+		details::hexdump_line(fmt::appender(d_out), d_offset, data, size);
+		d_offset += size;
+		if (d_out.size() >= d_flushSize) {
+			flush();
+		}
+	}
+
+	void flush() {
+		if (d_out.size() == 0) {
+			return;
+		}
+		d_sink({d_out.data(), d_out.size()});
+		d_out.clear();
+	}
+
+	Sink                 d_sink;
+	size_t               d_flushSize;
+	fmt::memory_buffer   d_out;
+	std::array<char, 16> d_line;
+	size_t               d_lineSize = 0;
+	size_t               d_offset   = 0;
+};
+
+} // namespace clserpp
+} // namespace fort
+
+template <> struct fmt::formatter<fort::clserpp::HexdumpView> {
+	constexpr auto parse(format_parse_context &ctx) -> decltype(ctx.begin()) {
+		return ctx.begin();
+	}
+
+	template <typename FormatContext>
+	auto format(const fort::clserpp::HexdumpView &view, FormatContext &ctx)
+	    const -> decltype(ctx.out()) {
+		return fort::clserpp::details::hexdump(ctx.out(), view.data, view.size);
+	}
+};
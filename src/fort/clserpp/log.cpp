@@ -0,0 +1,47 @@
+#include <gtest/gtest.h>
+
+#include "log.hpp"
+
+using namespace fort::clserpp;
+
+TEST(Log, ParsesLevels) {
+	details::LogLevels levels;
+	levels.Parse("info,io=debug,bulk=trace,unknown=debug");
+	EXPECT_EQ(levels.levels[size_t(LogComponent::IO)], spdlog::level::debug);
+	EXPECT_EQ(levels.levels[size_t(LogComponent::BULK)], spdlog::level::trace);
+	EXPECT_EQ(levels.levels[size_t(LogComponent::CACHE)], spdlog::level::info);
+}
+
+TEST(Log, ArgumentsAreLazy) {
+	const auto previous = GetLogLevel(LogComponent::IO);
+	size_t     built    = 0;
+	const auto argument = [&]() { return ++built; };
+
+	SetLogLevel(LogComponent::IO, spdlog::level::off);
+	CLSERPP_RUNTIME_LOG(
+	    LogComponent::IO,
+	    spdlog::level::debug,
+	    "value: {}",
+	    argument()
+	);
+	EXPECT_EQ(built, 0);
+
+	SetLogLevel(LogComponent::IO, spdlog::level::debug);
+	CLSERPP_RUNTIME_LOG(
+	    LogComponent::IO,
+	    spdlog::level::debug,
+	    "value: {}",
+	    argument()
+	);
+	EXPECT_EQ(built, 1);
+
+	// without CLSERPP_TRACE, arguments are never evaluated.
+	CLSERPP_DEBUG(IO, "value: {}", argument());
+	EXPECT_EQ(built, CLSERPP_TRACE ? 2 : 1);
+
+	SetLogLevel(LogComponent::IO, previous);
+}
+
+TEST(Log, EscapesLazily) {
+	EXPECT_EQ(fmt::format("{}", Escaped("a\r\n\tb")), "a\\r\\n\\tb");
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+
+#include <spdlog/spdlog.h>
+
+#include "escape.hpp"
+
+// Library traces are compiled out unless CLSERPP_TRACE is set, independently
+// of SPDLOG_ACTIVE_LEVEL. When compiled in, each component has its own
+// runtime level, off by default, which can be set with SetLogLevel() or the
+// CLSERPP_LOG environment variable, i.e. CLSERPP_LOG="io=debug,bulk=trace"
+// or CLSERPP_LOG=debug. Arguments are only evaluated for enabled levels.
+#ifndef CLSERPP_TRACE
+#define CLSERPP_TRACE 0
+#endif
+
+// Logs if the runtime level of component enables level, whatever
+// CLSERPP_TRACE is.
+#define CLSERPP_RUNTIME_LOG(component, level, ...)                             \
+	do {                                                                       \
+		if (::fort::clserpp::details::log_enabled(component, level)) {         \
+			spdlog::default_logger_raw()->log(                                 \
+			    spdlog::source_loc{__FILE__, __LINE__, SPDLOG_FUNCTION},       \
+			    level,                                                         \
+			    __VA_ARGS__                                                    \
+			);                                                                 \
+		}                                                                      \
+	} while (0)
+
+#if CLSERPP_TRACE
+#define CLSERPP_LOG(component, level, ...)                                     \
+	CLSERPP_RUNTIME_LOG(component, level, __VA_ARGS__)
+#else
+#define CLSERPP_LOG(component, level, ...) (void)0
+#endif
+
+#define CLSERPP_DEBUG(component, ...)                                          \
+	CLSERPP_LOG(                                                               \
+	    ::fort::clserpp::LogComponent::component,                              \
+	    spdlog::level::debug,                                                  \
+	    __VA_ARGS__                                                            \
+	)
+
+namespace fort {
+namespace clserpp {
+
+enum class LogComponent {
+	IO          = 0,
+	NEGOTIATION = 1,
+	BULK        = 2,
+	CACHE       = 3,
+};
+
+namespace details {
+
+const static size_t LOG_COMPONENTS = 4;
+
+const static std::array<const char *, LOG_COMPONENTS> log_components = {
+    "io",
+    "negotiation",
+    "bulk",
+    "cache",
+};
+
+struct LogLevels {
+	LogLevels() {
+		for (auto &level : levels) {
+			level.store(spdlog::level::off);
+		}
+		if (const char *env = std::getenv("CLSERPP_LOG")) {
+			Parse(env);
+		}
+	}
+
+	// parses a comma separated list of "<component>=<level>" or "<level>".
+	// Unknown components are ignored, unknown levels are off.
+	void Parse(std::string_view spec) {
+		while (spec.empty() == false) {
+			const auto comma = spec.find(',');
+			const auto item  = spec.substr(0, comma);
+			spec.remove_prefix(
+			    comma == std::string_view::npos ? spec.size() : comma + 1
+			);
+
+			const auto equal = item.find('=');
+			const auto level = spdlog::level::from_str(std::string{
+			    equal == std::string_view::npos ? item : item.substr(equal + 1)
+			});
+			if (equal == std::string_view::npos) {
+				for (auto &l : levels) {
+					l.store(level);
+				}
+				continue;
+			}
+			const auto name = item.substr(0, equal);
+			for (size_t i = 0; i < LOG_COMPONENTS; ++i) {
+				if (name == log_components[i]) {
+					levels[i].store(level);
+				}
+			}
+		}
+	}
+
+	std::array<std::atomic<int>, LOG_COMPONENTS> levels;
+};
+
+inline LogLevels &log_levels() {
+	static LogLevels levels;
+	return levels;
+}
+
+inline bool
+log_enabled(LogComponent component, spdlog::level::level_enum level) {
+	return level >= log_levels().levels[size_t(component)].load(
+	                    std::memory_order_relaxed
+	                );
+}
+
+} // namespace details
+
+inline void
+SetLogLevel(LogComponent component, spdlog::level::level_enum level) {
+	details::log_levels().levels[size_t(component)].store(level);
+}
+
+inline spdlog::level::level_enum GetLogLevel(LogComponent component) {
+	return spdlog::level::level_enum(
+	    details::log_levels().levels[size_t(component)].load()
+	);
+}
+
+// Lazily escaped bytes, only formatted if the message is logged.
+struct EscapedView {
+	std::string_view value;
+};
+
+inline EscapedView Escaped(std::string_view value) {
+	return {value};
+}
+
+} // namespace clserpp
+} // namespace fort
+
+template <> struct fmt::formatter<fort::clserpp::EscapedView> {
+	constexpr auto parse(format_parse_context &ctx) -> decltype(ctx.begin()) {
+		return ctx.begin();
+	}
+
+	template <typename FormatContext>
+	auto format(const fort::clserpp::EscapedView &view, FormatContext &ctx)
+	    const -> decltype(ctx.out()) {
+		auto out = ctx.out();
+		char escaped[fort::clserpp::EscapedSizeMax(256)];
+		for (auto left = view.value; left.empty() == false;) {
+			const auto chunk = left.substr(0, 256);
+			left.remove_prefix(chunk.size());
+			const size_t size = fort::clserpp::Escape(chunk, escaped);
+			out               = std::copy(escaped, escaped + size, out);
+		}
+		return out;
+	}
+};
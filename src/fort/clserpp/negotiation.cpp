@@ -0,0 +1,192 @@
+#include <gtest/gtest.h>
+
+#include <deque>
+#include <memory>
+
+#include "buffered_io.hpp"
+#include "exceptions.hpp"
+#include "negotiation.hpp"
+
+using namespace fort::clserpp;
+
+class MockCamera {
+public:
+	clBaudrate_e cameraRate = CL_BAUDRATE_9600;
+	clBaudrate_e hostRate   = CL_BAUDRATE_9600;
+	// the camera refuses rates above cameraMaximum, and the link corrupts
+	// all replies above reliableMaximum.
+	clBaudrate_e cameraMaximum   = CL_BAUDRATE_921600;
+	clBaudrate_e reliableMaximum = CL_BAUDRATE_921600;
+
+	template <typename Container>
+	void Write(const Container &buf, uint32_t timeout_ms) {
+		if (cameraRate != hostRate) {
+			return;
+		}
+		d_input.append(&buf[0], buf.size());
+		for (auto pos = d_input.find('\r'); pos != std::string::npos;
+		     pos      = d_input.find('\r')) {
+			process(d_input.substr(0, pos));
+			d_input.erase(0, pos + 1);
+		}
+	}
+
+	template <typename Container>
+	void Read(Container &buf, uint32_t timeout_ms) {
+		size_t read = 0;
+		for (; read < buf.size() && d_output.empty() == false; ++read) {
+			buf[read] = d_output.front();
+			d_output.pop_front();
+		}
+		if (read < buf.size()) {
+			throw IOTimeout(read);
+		}
+	}
+
+	uint32_t BytesAvailable() const {
+		return d_output.size();
+	}
+
+	void Flush() {
+		d_output.clear();
+	}
+
+	std::vector<clBaudrate_e> SupportedBaudrates() const {
+		return {
+		    CL_BAUDRATE_9600,
+		    CL_BAUDRATE_19200,
+		    CL_BAUDRATE_38400,
+		    CL_BAUDRATE_57600,
+		    CL_BAUDRATE_115200,
+		    CL_BAUDRATE_230400,
+		    CL_BAUDRATE_460800,
+		    CL_BAUDRATE_921600,
+		};
+	}
+
+	void SetBaudrate(clBaudrate_e bd) {
+		hostRate = bd;
+	}
+
+private:
+	void process(const std::string &line) {
+		if (line == "id") {
+			reply("cam-42");
+			return;
+		}
+		if (line.rfind("baud=", 0) == 0) {
+			const auto value = std::stoul(line.substr(5));
+			for (const auto bd : SupportedBaudrates()) {
+				if (details::baudrate_value(bd) == value &&
+				    bd <= cameraMaximum) {
+					reply("OK");
+					cameraRate = bd;
+					return;
+				}
+			}
+		}
+		reply("ERR");
+	}
+
+	void reply(std::string value) {
+		if (hostRate > reliableMaximum) {
+			std::fill(value.begin(), value.end(), '?');
+		}
+		value += "\r\n>";
+		d_output.insert(d_output.end(), value.begin(), value.end());
+	}
+
+	std::string      d_input;
+	std::deque<char> d_output;
+};
+
+class NegotiationTest : public ::testing::Test {
+protected:
+	void SetUp() override {
+		camera = std::make_shared<MockCamera>();
+		buffer = std::make_unique<ReadBuffer<MockCamera>>(camera);
+
+		opts.switchCommand   = "baud={}";
+		opts.identifyCommand = "id";
+		opts.identifyReply   = "cam-42";
+		opts.rounds          = 4;
+		opts.timeout_ms      = 10;
+		opts.settleTime      = std::chrono::milliseconds{0};
+	}
+
+	std::shared_ptr<MockCamera>             camera;
+	std::unique_ptr<ReadBuffer<MockCamera>> buffer;
+	NegotiationOptions                      opts;
+};
+
+TEST_F(NegotiationTest, StepsUpToCameraMaximum) {
+	camera->cameraMaximum = CL_BAUDRATE_115200;
+
+	auto res = NegotiateBaudrate(*camera, *buffer, CL_BAUDRATE_9600, opts);
+
+	EXPECT_EQ(res.baudrate, CL_BAUDRATE_115200);
+	EXPECT_EQ(camera->cameraRate, CL_BAUDRATE_115200);
+	EXPECT_EQ(camera->hostRate, CL_BAUDRATE_115200);
+	// 5 verified rates, the refused 230400 and the fallback probe.
+	ASSERT_EQ(res.probes.size(), 7);
+	for (size_t i = 0; i < 5; ++i) {
+		EXPECT_TRUE(res.probes[i].Verified(0.0)) << "probe " << i;
+		EXPECT_GT(res.probes[i].bytesPerSecond, 0.0) << "probe " << i;
+	}
+	EXPECT_EQ(res.probes[5].baudrate, CL_BAUDRATE_230400);
+	EXPECT_EQ(res.probes[5].failures, opts.rounds);
+	EXPECT_EQ(res.probes[6].baudrate, CL_BAUDRATE_115200);
+	EXPECT_TRUE(res.probes[6].Verified(0.0));
+}
+
+TEST_F(NegotiationTest, FallsBackWhenLinkIsUnreliable) {
+	camera->reliableMaximum = CL_BAUDRATE_57600;
+
+	auto res = NegotiateBaudrate(*camera, *buffer, CL_BAUDRATE_9600, opts);
+
+	EXPECT_EQ(res.baudrate, CL_BAUDRATE_57600);
+	EXPECT_EQ(camera->cameraRate, CL_BAUDRATE_57600);
+	EXPECT_EQ(camera->hostRate, CL_BAUDRATE_57600);
+	EXPECT_EQ(res.probes.back().baudrate, CL_BAUDRATE_57600);
+	EXPECT_TRUE(res.probes.back().Verified(0.0));
+}
+
+TEST_F(NegotiationTest, RespectsMaximum) {
+	camera->cameraRate = CL_BAUDRATE_19200;
+	opts.maximum       = CL_BAUDRATE_38400;
+
+	auto res = NegotiateBaudrate(*camera, *buffer, CL_BAUDRATE_19200, opts);
+
+	EXPECT_EQ(res.baudrate, CL_BAUDRATE_38400);
+	EXPECT_EQ(res.probes.size(), 2);
+}
+
+TEST_F(NegotiationTest, ThrowsOnUnverifiedStartingRate) {
+	camera->cameraRate = CL_BAUDRATE_19200;
+
+	EXPECT_THROW(
+	    { NegotiateBaudrate(*camera, *buffer, CL_BAUDRATE_9600, opts); },
+	    cpptrace::runtime_error
+	);
+}
+
+TEST_F(NegotiationTest, ChecksSwitchCommand) {
+	opts.switchCommand = "baud";
+	EXPECT_THROW(
+	    { NegotiateBaudrate(*camera, *buffer, CL_BAUDRATE_9600, opts); },
+	    cpptrace::logic_error
+	);
+	EXPECT_EQ(
+	    details::format_switch_command("BR {}", CL_BAUDRATE_115200),
+	    "BR 115200"
+	);
+}
+
+TEST_F(NegotiationTest, RequiresIdentifyReply) {
+	opts.identifyReply = "";
+	EXPECT_THROW(
+	    { NegotiateBaudrate(*camera, *buffer, CL_BAUDRATE_9600, opts); },
+	    cpptrace::logic_error
+	);
+	EXPECT_EQ(camera->hostRate, CL_BAUDRATE_9600);
+}
@@ -0,0 +1,232 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cpptrace/exceptions.hpp>
+
+#include <spdlog/spdlog.h>
+
+#include "buffer.hpp"
+#include "buffered_io.hpp"
+#include "clser.h"
+#include "details.hpp"
+#include "exceptions.hpp"
+#include "log.hpp"
+#include "types.hpp"
+
+namespace fort {
+namespace clserpp {
+
+struct NegotiationOptions {
+	// camera command switching its baudrate, "{}" is replaced by the
+	// baudrate value, i.e. "baud={}".
+	std::string switchCommand;
+	// command used to verify the link, and a substring its reply must
+	// contain. identifyReply is required, as a garbled reply at a wrong
+	// baudrate may still end with the delimiter.
+	std::string identifyCommand;
+	std::string identifyReply;
+
+	LineTermination termination = LineTermination::CR;
+	std::string     delimiter   = "\r\n>";
+	uint32_t        timeout_ms  = 1000;
+
+	size_t rounds       = 8;
+	double maxErrorRate = 0.0;
+	// time left to the camera to apply a new baudrate.
+	std::chrono::milliseconds settleTime{50};
+
+	std::optional<clBaudrate_e> maximum = std::nullopt;
+};
+
+struct BaudrateProbe {
+	clBaudrate_e baudrate;
+	size_t       rounds         = 0;
+	size_t       failures       = 0;
+	double       bytesPerSecond = 0.0;
+
+	double ErrorRate() const {
+		if (rounds == 0) {
+			return 1.0;
+		}
+		return double(failures) / double(rounds);
+	}
+
+	bool Verified(double maxErrorRate) const {
+		return rounds > failures && ErrorRate() <= maxErrorRate;
+	}
+};
+
+struct NegotiationResult {
+	clBaudrate_e               baudrate;
+	std::vector<BaudrateProbe> probes;
+};
+
+namespace details {
+inline std::string
+format_switch_command(const std::string &tpl, clBaudrate_e baudrate) {
+	if (tpl.find("{}") == std::string::npos) {
+		throw cpptrace::logic_error(
+		    "baudrate switch command '" + tpl + "' has no '{}' placeholder"
+		);
+	}
+	return fmt::format(fmt::runtime(tpl), baudrate_value(baudrate));
+}
+
+template <typename Port>
+void resynchronize(Port &port, ReadBuffer<Port> &buffer) {
+	port.Flush();
+	buffer.Clear();
+}
+
+} // namespace details
+
+// Measures a link by performing opts.rounds identify round trips at the
+// current baudrate. Failed round trips resynchronize the link.
+template <typename Port>
+BaudrateProbe ProbeLink(
+    Port                     &port,
+    ReadBuffer<Port>         &buffer,
+    clBaudrate_e              baudrate,
+    const NegotiationOptions &opts
+) {
+	using clock = std::chrono::steady_clock;
+
+	const Buffer identify{opts.identifyCommand, opts.termination};
+
+	BaudrateProbe res{
+	    .baudrate       = baudrate,
+	    .rounds         = 0,
+	    .failures       = 0,
+	    .bytesPerSecond = 0.0,
+	};
+
+	size_t                   bytes = 0;
+	std::chrono::nanoseconds elapsed{0};
+
+	for (; res.rounds < opts.rounds; ++res.rounds) {
+		const auto start = clock::now();
+		try {
+			port.Write(identify, opts.timeout_ms);
+			const auto reply =
+			    buffer.ReadUntil(opts.timeout_ms, opts.delimiter);
+			if (reply.find(opts.identifyReply) == std::string::npos) {
+				CLSERPP_DEBUG(
+				    NEGOTIATION,
+				    "unexpected identify reply at {}: '{}'",
+				    details::baudrate_value(baudrate),
+				    Escaped(reply)
+				);
+				++res.failures;
+				details::resynchronize(port, buffer);
+				continue;
+			}
+			elapsed += clock::now() - start;
+			bytes += identify.size() + reply.size();
+		} catch (const IOTimeout &) {
+			++res.failures;
+			details::resynchronize(port, buffer);
+		}
+	}
+
+	if (elapsed.count() > 0) {
+		res.bytesPerSecond =
+		    bytes / std::chrono::duration<double>(elapsed).count();
+	}
+	return res;
+}
+
+// Steps the link up through the supported baudrates, starting from
+// current. Each rate is kept only if ProbeLink verifies it, otherwise the
+// camera and the port are switched back to the last verified rate and the
+// negotiation stops. Throws if the link cannot be verified at the starting
+// rate or after a fallback.
+template <typename Port>
+NegotiationResult NegotiateBaudrate(
+    Port                     &port,
+    ReadBuffer<Port>         &buffer,
+    clBaudrate_e              current,
+    const NegotiationOptions &opts
+) {
+	if (opts.identifyReply.empty()) {
+		throw cpptrace::logic_error(
+		    "baudrate negotiation requires an expected identify reply"
+		);
+	}
+
+	const auto switchTo = [&](clBaudrate_e from, clBaudrate_e to) {
+		const Buffer command{
+		    details::format_switch_command(opts.switchCommand, to),
+		    opts.termination,
+		};
+		try {
+			port.Write(command, opts.timeout_ms);
+			// the acknowledgement may come at either rate, we do not
+			// rely on it.
+			buffer.ReadUntil(opts.timeout_ms, opts.delimiter);
+		} catch (const IOTimeout &) {
+		}
+		std::this_thread::sleep_for(opts.settleTime);
+		port.SetBaudrate(to);
+		details::resynchronize(port, buffer);
+		SPDLOG_INFO(
+		    "baudrate switched from {} to {}",
+		    details::baudrate_value(from),
+		    details::baudrate_value(to)
+		);
+	};
+
+	NegotiationResult res{.baudrate = current, .probes = {}};
+
+	port.SetBaudrate(current);
+	details::resynchronize(port, buffer);
+	res.probes.push_back(ProbeLink(port, buffer, current, opts));
+	if (res.probes.back().Verified(opts.maxErrorRate) == false) {
+		throw cpptrace::runtime_error(
+		    "could not verify link at starting baudrate " +
+		    std::to_string(details::baudrate_value(current))
+		);
+	}
+
+	auto candidates = port.SupportedBaudrates();
+	std::sort(candidates.begin(), candidates.end());
+
+	for (const auto next : candidates) {
+		if (next <= res.baudrate ||
+		    (opts.maximum.has_value() && next > opts.maximum.value())) {
+			continue;
+		}
+
+		switchTo(res.baudrate, next);
+		res.probes.push_back(ProbeLink(port, buffer, next, opts));
+		if (res.probes.back().Verified(opts.maxErrorRate)) {
+			res.baudrate = next;
+			continue;
+		}
+
+		SPDLOG_WARN(
+		    "could not verify link at {}, falling back to {}",
+		    details::baudrate_value(next),
+		    details::baudrate_value(res.baudrate)
+		);
+		switchTo(next, res.baudrate);
+		res.probes.push_back(ProbeLink(port, buffer, res.baudrate, opts));
+		if (res.probes.back().Verified(opts.maxErrorRate) == false) {
+			throw cpptrace::runtime_error(
+			    "link lost after failed switch to " +
+			    std::to_string(details::baudrate_value(next))
+			);
+		}
+		break;
+	}
+
+	return res;
+}
+
+} // namespace clserpp
+} // namespace fort
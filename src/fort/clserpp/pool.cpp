@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "buffer.hpp"
+#include "pool.hpp"
+
+using namespace fort::clserpp;
+
+TEST(Pool, SizeClasses) {
+	EXPECT_EQ(details::pool_class(1), 0);
+	EXPECT_EQ(details::pool_class(16), 0);
+	EXPECT_EQ(details::pool_class(17), 1);
+	EXPECT_EQ(details::pool_class(100), 3);
+	EXPECT_EQ(details::pool_class(details::POOL_MAX_BLOCK), 8);
+}
+
+// see allocations.cpp for the allocations of whole round trips.
+TEST(Pool, SteadyBuffersAreReused) {
+	const std::string commands[] = {"exp?", "exposure=1000", "gain=2", "id?"};
+	for (const auto &c : commands) {
+		Buffer command{c, LineTermination::CRLF};
+		Buffer reply{16};
+	}
+
+	const auto before = GetBufferPoolStats();
+	for (size_t i = 0; i < 1000; ++i) {
+		Buffer command{commands[i % 4], LineTermination::CRLF};
+		Buffer reply{16};
+		EXPECT_EQ(command.back(), '\n');
+	}
+	const auto after = GetBufferPoolStats();
+	EXPECT_EQ(after.allocations, before.allocations);
+	EXPECT_EQ(after.reuses, before.reuses + 2000);
+}
+
+TEST(Pool, BoundsCachedBlocks) {
+	const auto count = details::POOL_MAX_CACHED + 8;
+	{
+		std::vector<Buffer> buffers;
+		for (size_t i = 0; i < count; ++i) {
+			buffers.emplace_back(200);
+		}
+	}
+	const auto before = GetBufferPoolStats();
+	std::vector<Buffer> buffers;
+	for (size_t i = 0; i < count; ++i) {
+		buffers.emplace_back(200);
+	}
+	const auto after = GetBufferPoolStats();
+	// the vector of Buffers itself is not pooled.
+	EXPECT_EQ(after.reuses - before.reuses, details::POOL_MAX_CACHED);
+	EXPECT_EQ(after.allocations - before.allocations, 8);
+}
+
+TEST(Pool, LargeBuffersAreNotCached) {
+	{ Buffer large{2 * details::POOL_MAX_BLOCK}; }
+	const auto before = GetBufferPoolStats();
+	{ Buffer large{2 * details::POOL_MAX_BLOCK}; }
+	EXPECT_EQ(GetBufferPoolStats().allocations, before.allocations + 1);
+}
+
+TEST(Pool, ReleasesToTheFreeingThread) {
+	auto buffer = std::make_unique<Buffer>(std::string(300, 'x'));
+	std::thread([&buffer]() {
+		const auto before = GetBufferPoolStats();
+		buffer.reset();
+		Buffer reused{std::string(300, 'y')};
+		const auto after = GetBufferPoolStats();
+		EXPECT_EQ(after.allocations, before.allocations);
+		EXPECT_EQ(after.reuses, before.reuses + 1);
+	}).join();
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <new>
+#include <utility>
+
+namespace fort {
+namespace clserpp {
+
+struct BufferPoolStats {
+	// blocks obtained from operator new, and blocks taken from a free list.
+	size_t allocations = 0, reuses = 0;
+};
+
+namespace details {
+
+// size classes are powers of two, from 16 bytes to 4 KiB.
+const static size_t POOL_MIN_BLOCK = 16;
+const static size_t POOL_CLASSES   = 9;
+const static size_t POOL_MAX_BLOCK = POOL_MIN_BLOCK << (POOL_CLASSES - 1);
+// blocks kept per size class and thread.
+const static size_t POOL_MAX_CACHED = 32;
+
+constexpr size_t pool_class(size_t bytes) {
+	size_t res = 0;
+	for (; (POOL_MIN_BLOCK << res) < bytes; ++res) {
+	}
+	return res;
+}
+
+// trivially destructible, so it stays readable while the other thread_local
+// objects are destroyed.
+enum class PoolState { NONE, ALIVE, DESTROYED };
+inline thread_local PoolState pool_state = PoolState::NONE;
+
+// Free lists of a thread. Blocks may be released by another thread than the
+// one which allocated them, they then join the free list of the releasing
+// thread.
+class BufferPool {
+public:
+	BufferPool() {
+		pool_state = PoolState::ALIVE;
+	}
+
+	~BufferPool() {
+		pool_state = PoolState::DESTROYED;
+		for (auto &head : d_free) {
+			while (head != nullptr) {
+				::operator delete(std::exchange(head, head->next));
+			}
+		}
+	}
+
+	void *Allocate(size_t bytes) {
+		if (bytes > POOL_MAX_BLOCK) {
+			++d_stats.allocations;
+			return ::operator new(bytes);
+		}
+		const size_t c = pool_class(bytes);
+		if (auto block = d_free[c]; block != nullptr) {
+			++d_stats.reuses;
+			d_free[c] = block->next;
+			--d_cached[c];
+			return block;
+		}
+		++d_stats.allocations;
+		return ::operator new(POOL_MIN_BLOCK << c);
+	}
+
+	void Deallocate(void *ptr, size_t bytes) {
+		if (bytes > POOL_MAX_BLOCK) {
+			::operator delete(ptr);
+			return;
+		}
+		const size_t c = pool_class(bytes);
+		if (d_cached[c] >= POOL_MAX_CACHED) {
+			::operator delete(ptr);
+			return;
+		}
+		d_free[c] = new (ptr) FreeBlock{d_free[c]};
+		++d_cached[c];
+	}
+
+	const BufferPoolStats &Stats() const {
+		return d_stats;
+	}
+
+private:
+	struct FreeBlock {
+		FreeBlock *next;
+	};
+
+	std::array<FreeBlock *, POOL_CLASSES> d_free{};
+	std::array<size_t, POOL_CLASSES>      d_cached{};
+	BufferPoolStats                       d_stats;
+};
+
+inline BufferPool &buffer_pool() {
+	thread_local BufferPool pool;
+	return pool;
+}
+
+} // namespace details
+
+// Allocator backed by thread local free lists, for the small and short
+// lived objects of a transaction, i.e. a Buffer. Once warm, steady command
+// traffic does not call operator new.
+template <typename T> class PoolAllocator {
+public:
+	static_assert(
+	    alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__,
+	    "over-aligned types are not supported"
+	);
+
+	using value_type = T;
+
+	PoolAllocator() = default;
+
+	template <typename U> PoolAllocator(const PoolAllocator<U> &) noexcept {}
+
+	T *allocate(size_t n) {
+		// i.e. a static Buffer destroyed after the pool of the main thread.
+		if (details::pool_state == details::PoolState::DESTROYED) {
+			return static_cast<T *>(::operator new(n * sizeof(T)));
+		}
+		return static_cast<T *>(details::buffer_pool().Allocate(n * sizeof(T)));
+	}
+
+	void deallocate(T *ptr, size_t n) noexcept {
+		if (details::pool_state == details::PoolState::DESTROYED) {
+			::operator delete(ptr);
+			return;
+		}
+		details::buffer_pool().Deallocate(ptr, n * sizeof(T));
+	}
+
+	template <typename U> bool operator==(const PoolAllocator<U> &) const {
+		return true;
+	}
+
+	template <typename U> bool operator!=(const PoolAllocator<U> &) const {
+		return false;
+	}
+};
+
+// allocation counters of the calling thread.
+inline BufferPoolStats GetBufferPoolStats() {
+	return details::buffer_pool().Stats();
+}
+
+} // namespace clserpp
+} // namespace fort
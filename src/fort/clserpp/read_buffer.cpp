@@ -5,6 +5,7 @@
 #include "exceptions.hpp"
 
 #include <memory>
+#include <thread>
 #include <spdlog/sinks/stdout_sinks.h>
 #include <spdlog/spdlog.h>
 
@@ -18,6 +19,7 @@ public:
 
 	template <typename Container>
 	void Read(Container &buf, uint32_t timeout_ms) {
+		++reads;
 		const auto end = std::min(d_data.cend(), d_next + buf.size());
 		std::copy(d_next, end, &buf[0]);
 		size_t read = std::distance(d_next, end);
@@ -33,6 +35,8 @@ public:
 
 	void Flush() const {}
 
+	size_t reads = 0;
+
 private:
 	Buffer                 d_data;
 	Buffer::const_iterator d_next;
@@ -86,3 +90,94 @@ TEST(ReadBuffer, CanReadComplexDelimiter) {
 	EXPECT_EQ(buffer.ReadUntil(1000, "\r\n>"), "foo\r\n>");
 	EXPECT_EQ(buffer.Reminder(), "");
 }
+
+TEST(ReadBuffer, CanReadViews) {
+	auto reader = std::make_shared<MockReader>(Buffer{"exp=1200\r\n>gain=2"});
+	auto buffer = ReadBuffer(reader);
+	const auto view = buffer.ReadUntilView(1000, "\r\n>");
+	EXPECT_EQ(view, "exp=1200\r\n>");
+	EXPECT_EQ(view.data(), buffer.Bytes().data());
+	EXPECT_THROW({ buffer.ReadUntilView(1000, "\r\n>"); }, IOTimeout);
+}
+
+TEST(ReadBuffer, IteratesOverPendingLines) {
+	auto reader = std::make_shared<MockReader>(Buffer{"a\nbb\n\nccc"});
+	auto buffer = ReadBuffer(reader);
+
+	std::vector<std::string> lines;
+	for (auto line : buffer.Lines(1000)) {
+		lines.push_back(std::string(line));
+	}
+	EXPECT_EQ(lines, std::vector<std::string>({"a\n", "bb\n", "\n"}));
+	EXPECT_EQ(reader->reads, 1);
+	EXPECT_EQ(buffer.Reminder(), "ccc");
+
+	auto exhausted = buffer.Lines(1000);
+	EXPECT_TRUE(exhausted.begin() == exhausted.end());
+	EXPECT_EQ(reader->reads, 1);
+}
+
+TEST(ReadBuffer, CanReadLinesLargerThanFreeSpace) {
+	const std::string first(3000, 'a'), second(3000, 'b');
+	auto              reader =
+	    std::make_shared<MockReader>(Buffer{first + "\n" + second + "\n"});
+	auto buffer = ReadBuffer(reader);
+
+	EXPECT_EQ(buffer.ReadUntil(1000), first + "\n");
+	EXPECT_EQ(buffer.ReadUntil(1000), second + "\n");
+}
+
+class StreamReader {
+public:
+	void Push(const std::string &data) {
+		d_pending += data;
+	}
+
+	template <typename Container>
+	void Read(Container &buf, uint32_t timeout_ms) {
+		const size_t read = std::min(buf.size(), d_pending.size());
+		std::copy(d_pending.begin(), d_pending.begin() + read, &buf[0]);
+		d_pending.erase(0, read);
+		if (read < buf.size()) {
+			throw IOTimeout(read);
+		}
+	}
+
+	uint32_t BytesAvailable() const {
+		return d_pending.size();
+	}
+
+private:
+	std::string d_pending;
+};
+
+TEST(ReadBuffer, StampsArrivalTimes) {
+	using clock = std::chrono::steady_clock;
+
+	auto reader = std::make_shared<StreamReader>();
+	auto buffer = ReadBuffer(reader);
+
+	const auto start = clock::now();
+	reader->Push("exp=");
+	// reads the partial line, without yielding it.
+	auto pending = buffer.Lines(1000);
+	EXPECT_TRUE(pending.begin() == pending.end());
+	EXPECT_EQ(buffer.Reminder(), "exp=");
+	std::this_thread::sleep_for(std::chrono::milliseconds{5});
+	reader->Push("1\n");
+	const auto line  = buffer.ReadUntilView(1000);
+	const auto times = buffer.Arrival(line);
+	const auto end   = clock::now();
+
+	EXPECT_EQ(line, "exp=1\n");
+	EXPECT_GE(times.first, start);
+	EXPECT_GE(times.last - times.first, std::chrono::milliseconds{5});
+	EXPECT_LE(times.last, end);
+	EXPECT_EQ(buffer.Arrival(line.substr(0, 4)).last, times.first);
+	EXPECT_EQ(buffer.Arrival(line.substr(4)).first, times.last);
+
+	EXPECT_THROW(
+	    { buffer.Arrival(std::string_view{"foo"}); },
+	    cpptrace::logic_error
+	);
+}
@@ -0,0 +1,192 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "buffered_io.hpp"
+#include "exceptions.hpp"
+#include "pool.hpp"
+#include "statistics.hpp"
+
+using namespace fort::clserpp;
+using soak_clock = std::chrono::steady_clock;
+
+// A Reader fed by a producer thread. Read() waits until the requested bytes
+// are available, or times out with the bytes received so far.
+class ChunkedReader {
+public:
+	void Push(const char *data, size_t size) {
+		{
+			std::lock_guard<std::mutex> lock{d_mutex};
+			d_pending.insert(d_pending.end(), data, data + size);
+			d_pushed += size;
+			d_arrivals.push_back({d_pushed, soak_clock::now()});
+		}
+		d_available.notify_all();
+	}
+
+	template <typename Container>
+	void Read(Container &buf, uint32_t timeout_ms) {
+		std::unique_lock<std::mutex> lock{d_mutex};
+		d_available.wait_for(
+		    lock,
+		    std::chrono::milliseconds(timeout_ms),
+		    [&]() { return d_pending.size() >= buf.size(); }
+		);
+		const size_t size = std::min(buf.size(), d_pending.size());
+		std::copy(d_pending.begin(), d_pending.begin() + size, &buf[0]);
+		d_pending.erase(d_pending.begin(), d_pending.begin() + size);
+		if (size < buf.size()) {
+			throw IOTimeout(size);
+		}
+	}
+
+	uint32_t BytesAvailable() {
+		std::lock_guard<std::mutex> lock{d_mutex};
+		return d_pending.size();
+	}
+
+	void Flush() {}
+
+	// time at which the byte at offset in the stream was pushed.
+	soak_clock::time_point Arrival(uint64_t offset) {
+		std::lock_guard<std::mutex> lock{d_mutex};
+		const auto it = std::upper_bound(
+		    d_arrivals.begin(),
+		    d_arrivals.end(),
+		    offset,
+		    [](uint64_t offset, const Chunk &c) { return offset < c.first; }
+		);
+		return it->second;
+	}
+
+private:
+	// end offset of a pushed chunk in the stream, and its push time.
+	using Chunk = std::pair<uint64_t, soak_clock::time_point>;
+
+	std::mutex              d_mutex;
+	std::condition_variable d_available;
+	std::deque<char>        d_pending;
+	uint64_t                d_pushed = 0;
+	std::vector<Chunk>      d_arrivals;
+};
+
+size_t soakLines() {
+	if (const char *env = std::getenv("CLSERPP_SOAK_LINES")) {
+		return std::strtoul(env, nullptr, 10);
+	}
+	return 2000;
+}
+
+// Lines are mostly short replies, with some close to the capacity of the
+// buffer. The stream is split at random, often inside the delimiter, and
+// delivered with random pauses.
+TEST(ReadBufferSoak, RandomChunking) {
+	const std::string delim    = "\r\n>";
+	const size_t      lines    = soakLines();
+	const size_t      capacity = 4096;
+
+	std::mt19937                          rng{1234};
+	std::uniform_int_distribution<size_t> percent{0, 99}, shortLength{0, 64},
+	    mediumLength{65, 1024},
+	    longLength{capacity - 600, capacity - delim.size()};
+	std::uniform_int_distribution<int> printable{' ', '~'};
+
+	std::vector<std::string> expected;
+	std::string              stream;
+	for (size_t i = 0; i < lines; ++i) {
+		const auto kind   = percent(rng);
+		const auto length = kind < 70   ? shortLength(rng)
+		                    : kind < 90 ? mediumLength(rng)
+		                                : longLength(rng);
+		std::string line;
+		while (line.size() < length) {
+			// '>' only appears in the delimiter, so lines never contain it.
+			if (char c = printable(rng); c != '>') {
+				line.push_back(c);
+			}
+		}
+		line += delim;
+		stream += line;
+		expected.push_back(std::move(line));
+	}
+
+	auto reader = std::make_shared<ChunkedReader>();
+
+	std::thread producer([&reader, &stream]() {
+		std::mt19937                          rng{4321};
+		std::uniform_int_distribution<size_t> percent{0, 99}, tiny{1, 3},
+		    chunk{1, 512}, pause{1, 200};
+		for (size_t offset = 0; offset < stream.size();) {
+			const size_t size = std::min(
+			    stream.size() - offset,
+			    percent(rng) < 20 ? tiny(rng) : chunk(rng)
+			);
+			reader->Push(stream.data() + offset, size);
+			offset += size;
+			if (percent(rng) < 10) {
+				const std::chrono::microseconds duration{pause(rng)};
+				std::this_thread::sleep_for(duration);
+			}
+		}
+	});
+
+	auto                buffer = ReadBuffer<ChunkedReader>{reader};
+	std::vector<double> latencies;
+	latencies.reserve(lines);
+	uint64_t     offset      = 0;
+	size_t       mismatches  = 0;
+	// counted once the first line is read and the arrival stamps are pooled.
+	size_t allocations = 0;
+
+	// a failed read must not leave the producer joinable.
+	try {
+		for (const auto &line : expected) {
+			const auto got = buffer.ReadUntilView(1000, delim);
+			const auto now = soak_clock::now();
+			offset += got.size();
+			if (got != line) {
+				++mismatches;
+			}
+			const auto latency = now - reader->Arrival(offset - 1);
+			latencies.push_back(
+			    std::chrono::duration<double, std::micro>(latency).count()
+			);
+			if (latencies.size() == 1) {
+				allocations = GetBufferPoolStats().allocations;
+			}
+		}
+	} catch (const std::exception &e) {
+		ADD_FAILURE() << "soak failed after " << latencies.size()
+		              << " lines: " << e.what();
+	}
+	const size_t allocated = GetBufferPoolStats().allocations - allocations;
+	producer.join();
+
+	EXPECT_EQ(mismatches, 0);
+	EXPECT_EQ(offset, stream.size());
+	EXPECT_EQ(buffer.BytesAvailable(), 0);
+	// a burst may grow the stamps by a block, but never with every line.
+	EXPECT_LE(allocated, 4);
+
+	if (latencies.empty()) {
+		return;
+	}
+	const auto s = Summarize(latencies);
+	RecordProperty("lines", int(lines));
+	RecordProperty("bytes", int(stream.size()));
+	RecordProperty("latency_p50_us", int(s.median));
+	RecordProperty("latency_p99_us", int(s.p99));
+	RecordProperty("latency_p999_us", int(s.p999));
+	RecordProperty("latency_max_us", int(s.max));
+	RecordProperty("pool_allocations", int(allocated));
+}
@@ -0,0 +1,284 @@
+#include <gtest/gtest.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "buffered_io.hpp"
+#include "daemon.hpp"
+#include "exceptions.hpp"
+#include "remote.hpp"
+
+using namespace fort::clserpp;
+
+// A port echoing every written byte.
+class LoopbackPort {
+public:
+	template <typename Container>
+	void Write(const Container &buf, uint32_t timeout_ms) {
+		std::lock_guard<std::mutex> lock{d_mutex};
+		size_t                      size = buf.size();
+		if (limit > 0) {
+			size = std::min(size, limit - d_written);
+		}
+		d_written += size;
+		for (size_t i = 0; i < size; ++i) {
+			d_data.push_back(buf[i]);
+		}
+		d_condition.notify_all();
+		if (size < buf.size()) {
+			throw IOTimeout(size);
+		}
+	}
+
+	template <typename Container>
+	void Read(Container &buf, uint32_t timeout_ms) {
+		std::unique_lock<std::mutex> lock{d_mutex};
+		d_condition.wait_for(
+		    lock,
+		    std::chrono::milliseconds{timeout_ms},
+		    [&]() { return d_data.size() >= buf.size(); }
+		);
+		size_t read = std::min(buf.size(), d_data.size());
+		for (size_t i = 0; i < read; ++i) {
+			buf[i] = d_data.front();
+			d_data.pop_front();
+		}
+		if (read < buf.size()) {
+			throw IOTimeout(read);
+		}
+	}
+
+	uint32_t BytesAvailable() {
+		std::lock_guard<std::mutex> lock{d_mutex};
+		return d_data.size();
+	}
+
+	void Flush() {
+		std::lock_guard<std::mutex> lock{d_mutex};
+		d_data.clear();
+	}
+
+	std::vector<clBaudrate_e> SupportedBaudrates() const {
+		return {CL_BAUDRATE_9600, CL_BAUDRATE_115200};
+	}
+
+	void SetBaudrate(clBaudrate_e bd) {
+		baudrate = bd;
+	}
+
+	std::atomic<clBaudrate_e> baudrate{CL_BAUDRATE_9600};
+	// when set, writes time out once limit bytes were written.
+	std::atomic<size_t> limit{0};
+
+private:
+	std::mutex              d_mutex;
+	std::condition_variable d_condition;
+	std::deque<char>        d_data;
+	size_t                  d_written = 0;
+};
+
+class DaemonTest : public ::testing::Test {
+protected:
+	void SetUp() override {
+		opts.socket = "/tmp/clserpp-test-" + std::to_string(::getpid()) +
+		              ".sock";
+		opts.pollTimeout_ms = 5;
+		opts.ringCapacity   = 4096;
+
+		port   = std::make_shared<LoopbackPort>();
+		server = std::make_unique<DaemonServer<LoopbackPort>>(
+		    [this](uint32_t index) {
+			    if (index != 0) {
+				    throw cpptrace::out_of_range("no such port");
+			    }
+			    return port;
+		    },
+		    []() {
+			    return std::vector<SerialDescription>{
+			        {.index = 0, .info = "loopback"},
+			    };
+		    },
+		    opts
+		);
+		thread = std::thread{[this]() { server->Run(); }};
+	}
+
+	void TearDown() override {
+		server->Stop();
+		thread.join();
+		server.reset();
+	}
+
+	DaemonOptions                               opts;
+	std::shared_ptr<LoopbackPort>               port;
+	std::unique_ptr<DaemonServer<LoopbackPort>> server;
+	std::thread                                 thread;
+};
+
+TEST_F(DaemonTest, ListsPorts) {
+	const auto descriptions = RemoteSerial::GetDescriptions(opts.socket);
+	ASSERT_EQ(descriptions.size(), 1);
+	EXPECT_EQ(descriptions[0].index, 0);
+	EXPECT_EQ(descriptions[0].info, "loopback");
+}
+
+TEST_F(DaemonTest, ReportsErrors) {
+	EXPECT_THROW(
+	    { RemoteSerial::Open(1, opts.socket); },
+	    cpptrace::runtime_error
+	);
+
+	auto              client  = RemoteSerial::Open(0, opts.socket);
+	const std::string command = "ping\n";
+	EXPECT_THROW(
+	    {
+		    client
+		        ->WriteAsync(command.data(), command.size(), Priority(3), 1000)
+		        .get();
+	    },
+	    cpptrace::runtime_error
+	);
+}
+
+TEST_F(DaemonTest, RefusesASecondDaemon) {
+	EXPECT_THROW(
+	    {
+		    DaemonServer<LoopbackPort>(
+		        [this](uint32_t) { return port; },
+		        []() { return std::vector<SerialDescription>{}; },
+		        opts
+		    );
+	    },
+	    cpptrace::runtime_error
+	);
+	EXPECT_EQ(RemoteSerial::GetDescriptions(opts.socket).size(), 1);
+}
+
+TEST_F(DaemonTest, SharesPortBetweenClients) {
+	std::shared_ptr<RemoteSerial> acquisition =
+	    RemoteSerial::Open(0, opts.socket);
+	std::shared_ptr<RemoteSerial> monitor = RemoteSerial::Open(0, opts.socket);
+
+	EXPECT_EQ(
+	    acquisition->SupportedBaudrates(),
+	    std::vector<clBaudrate_e>({CL_BAUDRATE_9600, CL_BAUDRATE_115200})
+	);
+	const auto generation = acquisition->Generation();
+	monitor->SetBaudrate(CL_BAUDRATE_115200);
+	EXPECT_EQ(port->baudrate.load(), CL_BAUDRATE_115200);
+	// the other client is notified asynchronously.
+	for (int i = 0; i < 100 && acquisition->Generation() == generation; ++i) {
+		std::this_thread::sleep_for(std::chrono::milliseconds{1});
+	}
+	EXPECT_NE(acquisition->Generation(), generation);
+
+	ReadBuffer<RemoteSerial> acquisitionBuffer{acquisition};
+	ReadBuffer<RemoteSerial> monitorBuffer{monitor};
+
+	acquisition->Write(Buffer{"exp=1200\r\n>"}, 1000);
+	EXPECT_EQ(acquisitionBuffer.ReadUntil(1000, "\r\n>"), "exp=1200\r\n>");
+	EXPECT_EQ(monitorBuffer.ReadUntil(1000, "\r\n>"), "exp=1200\r\n>");
+}
+
+TEST_F(DaemonTest, PipelinesWrites) {
+	std::shared_ptr<RemoteSerial> client = RemoteSerial::Open(0, opts.socket);
+	ReadBuffer<RemoteSerial>      buffer{client};
+
+	std::vector<std::future<void>> writes;
+	for (int i = 0; i < 10; ++i) {
+		const std::string command = "cmd" + std::to_string(i) + "\n";
+		writes.push_back(client->WriteAsync(
+		    command.data(),
+		    command.size(),
+		    Priority::NORMAL,
+		    1000
+		));
+	}
+	for (auto &w : writes) {
+		w.get();
+	}
+	for (int i = 0; i < 10; ++i) {
+		EXPECT_EQ(buffer.ReadUntil(1000), "cmd" + std::to_string(i) + "\n");
+	}
+}
+
+TEST_F(DaemonTest, ClosesPortsAfterTheLastClient) {
+	const auto waitRelease = [this]() {
+		for (int i = 0; i < 100 && port.use_count() > 1; ++i) {
+			std::this_thread::sleep_for(std::chrono::milliseconds{1});
+		}
+	};
+
+	auto first  = RemoteSerial::Open(0, opts.socket);
+	auto second = RemoteSerial::Open(0, opts.socket);
+	first.reset();
+	waitRelease();
+	EXPECT_GT(port.use_count(), 1);
+
+	second.reset();
+	waitRelease();
+	EXPECT_EQ(port.use_count(), 1);
+
+	// the port is opened again by the next client.
+	ReadBuffer<RemoteSerial> buffer{RemoteSerial::Open(0, opts.socket)};
+	EXPECT_GT(port.use_count(), 1);
+}
+
+TEST_F(DaemonTest, RestrictsSocketAccess) {
+	struct stat st;
+	ASSERT_EQ(::stat(opts.socket.c_str(), &st), 0);
+	EXPECT_EQ(st.st_mode & 0777, 0660);
+}
+
+TEST_F(DaemonTest, ReportsBytesWrittenBeforeATimeout) {
+	std::shared_ptr<RemoteSerial> client = RemoteSerial::Open(0, opts.socket);
+
+	// the daemon writes chunks of 19 bytes at 9600 bauds.
+	port->limit = 50;
+	const std::string data(100, 'x');
+	try {
+		client->Write(Buffer{data}, 1000);
+		ADD_FAILURE() << "should have thrown IOTimeout";
+	} catch (const IOTimeout &e) {
+		EXPECT_EQ(e.bytes(), 50);
+	}
+	std::string echoed(50, '\0');
+	client->Read(echoed, 1000);
+	EXPECT_EQ(echoed, data.substr(0, 50));
+}
+
+TEST_F(DaemonTest, ArbitratesExclusiveSessions) {
+	std::shared_ptr<RemoteSerial> calibration =
+	    RemoteSerial::Open(0, opts.socket);
+	std::shared_ptr<RemoteSerial> acquisition =
+	    RemoteSerial::Open(0, opts.socket);
+
+	calibration->Acquire(1000);
+	EXPECT_THROW({ acquisition->Write(Buffer{"trigger\n"}, 50); }, IOTimeout);
+	EXPECT_THROW({ acquisition->Acquire(50); }, IOTimeout);
+	EXPECT_THROW(
+	    { acquisition->SetBaudrate(CL_BAUDRATE_115200); },
+	    cpptrace::runtime_error
+	);
+	EXPECT_EQ(port->baudrate.load(), CL_BAUDRATE_9600);
+	calibration->SetBaudrate(CL_BAUDRATE_115200);
+	EXPECT_EQ(port->baudrate.load(), CL_BAUDRATE_115200);
+
+	ReadBuffer<RemoteSerial> buffer{calibration};
+	calibration->Write(Buffer{"gain?\n"}, 1000);
+	EXPECT_EQ(buffer.ReadUntil(1000), "gain?\n");
+	calibration->Release();
+
+	// the acquisition client never saw the private reply.
+	std::this_thread::sleep_for(std::chrono::milliseconds{20});
+	EXPECT_EQ(acquisition->BytesAvailable(), 0);
+
+	ReadBuffer<RemoteSerial> acquisitionBuffer{acquisition};
+	acquisition->Write(Buffer{"trigger\n"}, 1000);
+	EXPECT_EQ(acquisitionBuffer.ReadUntil(1000), "trigger\n");
+}
@@ -0,0 +1,441 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cpptrace/exceptions.hpp>
+
+#include "buffer.hpp"
+#include "clser.h"
+#include "clserpp.hpp"
+#include "daemon_protocol.hpp"
+#include "exceptions.hpp"
+#include "scheduler.hpp"
+#include "shm_ring.hpp"
+
+namespace fort {
+namespace clserpp {
+
+namespace details {
+
+// Connection to clserpp-daemon. Requests can be issued from any thread and
+// are pipelined: a dedicated thread dispatches the responses by request id.
+class DaemonClient {
+public:
+	struct Response {
+		DaemonResponse   header;
+		std::string      payload;
+		std::vector<int> fds;
+	};
+
+	using Callback = std::function<void(Response *response)>;
+	// called from the receiving thread for each notification.
+	using Listener = std::function<void(const DaemonResponse &notification)>;
+
+	DaemonClient(const std::string &path, Listener listener = {})
+	    : d_socket{connect_daemon(path)}
+	    , d_listener{std::move(listener)} {
+		d_receiver = std::thread{[this]() { receiveLoop(); }};
+	}
+
+	~DaemonClient() {
+		::shutdown(d_socket, SHUT_RDWR);
+		d_receiver.join();
+		::close(d_socket);
+	}
+
+	// callback is called from the receiving thread, with nullptr if the
+	// connection is lost.
+	void Request(
+	    DaemonRequest   request,
+	    const char     *payload,
+	    size_t          size,
+	    Callback      &&callback
+	) {
+		std::lock_guard<std::mutex> lock{d_mutex};
+		if (d_closed) {
+			throw cpptrace::runtime_error("connection to daemon lost");
+		}
+		if (++d_nextID == DAEMON_NOTIFICATION) {
+			++d_nextID;
+		}
+		request.id = d_nextID;
+		send_message(d_socket, request, payload, size);
+		d_pending.emplace(request.id, std::move(callback));
+	}
+
+	// Synchronous request, throws on error statuses.
+	Response Call(
+	    DaemonRequest request, const char *payload = nullptr, size_t size = 0
+	) {
+		auto promise = std::make_shared<std::promise<Response>>();
+		auto res     = promise->get_future();
+		Request(request, payload, size, [promise](Response *response) {
+			if (response == nullptr) {
+				promise->set_exception(std::make_exception_ptr(
+				    cpptrace::runtime_error("connection to daemon lost")
+				));
+				return;
+			}
+			promise->set_value(std::move(*response));
+		});
+		auto response = res.get();
+		Check(response);
+		return response;
+	}
+
+	static void Check(Response &response) {
+		switch (response.header.status) {
+		case DaemonStatus::OK:
+			return;
+		case DaemonStatus::TIMEOUT:
+			throw IOTimeout(response.header.value);
+		default:
+			throw cpptrace::runtime_error("daemon error: " + response.payload);
+		}
+	}
+
+private:
+	void receiveLoop() {
+		Response response;
+		while (true) {
+			try {
+				if (receive_message(
+				        d_socket,
+				        response.header,
+				        response.payload,
+				        response.fds
+				    ) == false) {
+					break;
+				}
+			} catch (const std::exception &e) {
+				SPDLOG_ERROR("daemon connection error: {}", e.what());
+				break;
+			}
+
+			if (response.header.id == DAEMON_NOTIFICATION) {
+				for (int fd : response.fds) {
+					::close(fd);
+				}
+				if (d_listener) {
+					d_listener(response.header);
+				}
+				continue;
+			}
+
+			Callback callback;
+			{
+				std::lock_guard<std::mutex> lock{d_mutex};
+				auto it = d_pending.find(response.header.id);
+				if (it != d_pending.end()) {
+					callback = std::move(it->second);
+					d_pending.erase(it);
+				}
+			}
+			if (callback) {
+				callback(&response);
+			} else {
+				for (int fd : response.fds) {
+					::close(fd);
+				}
+			}
+		}
+
+		std::unordered_map<uint32_t, Callback> pending;
+		{
+			std::lock_guard<std::mutex> lock{d_mutex};
+			d_closed = true;
+			std::swap(pending, d_pending);
+		}
+		for (auto &[id, callback] : pending) {
+			callback(nullptr);
+		}
+	}
+
+	int         d_socket;
+	Listener    d_listener;
+	std::thread d_receiver;
+
+	std::mutex                             d_mutex;
+	uint32_t                               d_nextID = 0;
+	bool                                   d_closed = false;
+	std::unordered_map<uint32_t, Callback> d_pending;
+};
+
+} // namespace details
+
+// Client side of a port shared through clserpp-daemon. It exposes the same
+// interface than Serial, and can therefore be used with a ReadBuffer.
+// Received bytes are delivered by the daemon into a shared memory ring;
+// Flush() only discards the bytes received by this client. Generation()
+// also changes when another client changes the baudrate.
+class RemoteSerial {
+public:
+	static std::unique_ptr<RemoteSerial>
+	Open(uint32_t idx, const std::string &socket) {
+		return std::unique_ptr<RemoteSerial>(new RemoteSerial(idx, socket));
+	}
+
+	static std::unique_ptr<RemoteSerial> Open(uint32_t idx) {
+		return Open(idx, details::default_daemon_socket());
+	}
+
+	static std::vector<SerialDescription> GetDescriptions() {
+		return GetDescriptions(details::default_daemon_socket());
+	}
+
+	static std::vector<SerialDescription>
+	GetDescriptions(const std::string &socket) {
+		details::DaemonClient client{socket};
+
+		auto response = client.Call({
+		    .id         = 0,
+		    .command    = details::DaemonCommand::LIST,
+		    .priority   = 0,
+		    .value      = 0,
+		    .timeout_ms = 0,
+		});
+
+		std::vector<SerialDescription> res;
+		std::istringstream             iss{response.payload};
+		std::string                    line;
+		while (std::getline(iss, line)) {
+			const auto tab = line.find('\t');
+			if (tab == std::string::npos) {
+				continue;
+			}
+			res.push_back({
+			    .index = uint32_t(std::stoul(line.substr(0, tab))),
+			    .info  = line.substr(tab + 1),
+			});
+		}
+		return res;
+	}
+
+	~RemoteSerial() {
+		d_client.reset();
+		::close(d_event);
+	}
+
+	void Flush() {
+		d_ring->Clear();
+		d_generation.store(details::next_generation());
+	}
+
+	template <typename Container>
+	void Read(Container &buf, uint32_t timeout_ms) {
+		const auto deadline = std::chrono::steady_clock::now() +
+		                      std::chrono::milliseconds{timeout_ms};
+		uint32_t read = 0;
+		while (true) {
+			uint64_t count;
+			(void)!::read(d_event, &count, sizeof(count));
+
+			read += d_ring->Read(&buf[read], buf.size() - read);
+			if (read == buf.size()) {
+				return;
+			}
+
+			const auto left =
+			    std::chrono::duration_cast<std::chrono::milliseconds>(
+			        deadline - std::chrono::steady_clock::now()
+			    );
+			if (left.count() <= 0) {
+				throw IOTimeout(read);
+			}
+			pollfd pfd{.fd = d_event, .events = POLLIN, .revents = 0};
+			::poll(&pfd, 1, left.count());
+		}
+	}
+
+	template <typename Container>
+	void Write(const Container &buf, uint32_t timeout_ms) {
+		uint32_t written = 0;
+		while (written < buf.size()) {
+			const size_t size =
+			    std::min(buf.size() - written, details::DAEMON_MAX_PAYLOAD);
+			try {
+				WriteAsync(&buf[written], size, Priority::NORMAL, timeout_ms)
+				    .get();
+			} catch (const IOTimeout &e) {
+				throw IOTimeout(written + e.bytes());
+			}
+			written += size;
+		}
+	}
+
+	// Pipelined write: several writes can be in flight, they are written
+	// in order. data must be at most DAEMON_MAX_PAYLOAD bytes.
+	std::future<void> WriteAsync(
+	    const char *data, size_t size, Priority priority, uint32_t timeout_ms
+	) {
+		if (size > details::DAEMON_MAX_PAYLOAD) {
+			throw cpptrace::logic_error(
+			    "write of " + std::to_string(size) + " bytes is too large"
+			);
+		}
+		auto promise = std::make_shared<std::promise<void>>();
+		auto res     = promise->get_future();
+		d_client->Request(
+		    {
+		        .id         = 0,
+		        .command    = details::DaemonCommand::WRITE,
+		        .priority   = uint16_t(priority),
+		        .value      = 0,
+		        .timeout_ms = timeout_ms,
+		    },
+		    data,
+		    size,
+		    [promise](details::DaemonClient::Response *response) {
+			    fulfill(*promise, response);
+		    }
+		);
+		return res;
+	}
+
+	uint32_t BytesAvailable() const {
+		return d_ring->Available();
+	}
+
+	// bytes lost because this client did not read them fast enough.
+	uint64_t Dropped() const {
+		return d_ring->Dropped();
+	}
+
+	const std::vector<clBaudrate_e> &SupportedBaudrates() const {
+		return d_supportedBaudrates;
+	}
+
+	void SetBaudrate(clBaudrate_e bd) {
+		d_client->Call({
+		    .id         = 0,
+		    .command    = details::DaemonCommand::SET_BAUDRATE,
+		    .priority   = 0,
+		    .value      = uint32_t(bd),
+		    .timeout_ms = 0,
+		});
+		d_generation.store(details::next_generation());
+	}
+
+	uint64_t Generation() const {
+		return d_generation.load();
+	}
+
+	// Starts an exclusive session: until Release(), received bytes are only
+	// delivered to this client and other clients cannot write.
+	void Acquire(uint32_t timeout_ms) {
+		d_client->Call({
+		    .id         = 0,
+		    .command    = details::DaemonCommand::ACQUIRE,
+		    .priority   = 0,
+		    .value      = 0,
+		    .timeout_ms = timeout_ms,
+		});
+	}
+
+	void Release() {
+		d_client->Call({
+		    .id         = 0,
+		    .command    = details::DaemonCommand::RELEASE,
+		    .priority   = 0,
+		    .value      = 0,
+		    .timeout_ms = 0,
+		});
+	}
+
+private:
+	static void
+	fulfill(std::promise<void> &promise, details::DaemonClient::Response *r) {
+		try {
+			if (r == nullptr) {
+				throw cpptrace::runtime_error("connection to daemon lost");
+			}
+			details::DaemonClient::Check(*r);
+			promise.set_value();
+		} catch (...) {
+			promise.set_exception(std::current_exception());
+		}
+	}
+
+	RemoteSerial(uint32_t idx, const std::string &socket)
+	    : d_client{std::make_unique<details::DaemonClient>(
+	          socket,
+	          [this](const details::DaemonResponse &notification) {
+		          if (notification.status ==
+		              details::DaemonStatus::BAUDRATE_CHANGED) {
+			          d_generation.store(details::next_generation());
+		          }
+	          }
+	      )} {
+		auto response = d_client->Call({
+		    .id         = 0,
+		    .command    = details::DaemonCommand::ATTACH,
+		    .priority   = 0,
+		    .value      = idx,
+		    .timeout_ms = 0,
+		});
+		if (response.fds.size() != 2) {
+			for (int fd : response.fds) {
+				::close(fd);
+			}
+			throw cpptrace::runtime_error("invalid attach response");
+		}
+		d_event = response.fds[1];
+		try {
+			d_ring = details::SharedRing::Map(response.fds[0]);
+		} catch (...) {
+			::close(d_event);
+			throw;
+		}
+
+		uint32_t baudrates = 0;
+		try {
+			const auto response = d_client->Call({
+			    .id         = 0,
+			    .command    = details::DaemonCommand::GET_BAUDRATES,
+			    .priority   = 0,
+			    .value      = 0,
+			    .timeout_ms = 0,
+			});
+			baudrates = response.header.value;
+		} catch (...) {
+			::close(d_event);
+			throw;
+		}
+		for (int i = 0; i < 32; i++) {
+			clBaudrate_e bd = clBaudrate_e(1 << i);
+			if ((baudrates & bd) != 0) {
+				d_supportedBaudrates.push_back(bd);
+			}
+		}
+	}
+
+	RemoteSerial(const RemoteSerial &other)            = delete;
+	RemoteSerial &operator=(const RemoteSerial &other) = delete;
+
+	// constructed first, as the daemon client may already use it.
+	std::atomic<uint64_t> d_generation{details::next_generation()};
+
+	std::unique_ptr<details::DaemonClient> d_client;
+	std::optional<details::SharedRing>     d_ring;
+	int                                    d_event = -1;
+	std::vector<clBaudrate_e>              d_supportedBaudrates;
+};
+
+} // namespace clserpp
+} // namespace fort
@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "reply.hpp"
+
+using namespace fort::clserpp;
+
+TEST(Reply, StripsEchoAndPrompt) {
+	auto reply = Reply::Parse("exp?\r\nexp=1200\r\n>", "exp?");
+	EXPECT_EQ(reply.Body(), "exp=1200");
+	EXPECT_EQ(reply.Number<int>("exp"), 1200);
+
+	// without echo, or with a body starting like the command.
+	EXPECT_EQ(Reply::Parse("exp=1200\r\n>", "exp?").Body(), "exp=1200");
+	EXPECT_EQ(Reply::Parse("exp=12\r\n>", "exp=12").Body(), "exp=12");
+	EXPECT_EQ(Reply::Parse("exp=12\r\nOK\r\n>", "exp=12\r").Body(), "OK");
+	EXPECT_EQ(Reply::Parse("\r\n>").Body(), "");
+}
+
+TEST(Reply, SplitsFields) {
+	auto reply = Reply::Parse("mode=ext, gain = 2.5,  12,,-3\r\n>");
+
+	std::vector<std::string_view> fields;
+	for (auto field : reply.Split()) {
+		fields.push_back(field);
+	}
+	const std::vector<std::string_view> expected = {
+	    "mode=ext",
+	    "gain = 2.5",
+	    "12",
+	    "",
+	    "-3",
+	};
+	EXPECT_EQ(fields, expected);
+
+	EXPECT_EQ(reply.Value("mode"), "ext");
+	EXPECT_EQ(reply.Number<double>("gain"), 2.5);
+	EXPECT_EQ(reply.Value("exposure"), std::nullopt);
+	EXPECT_EQ(reply.At(1), "2.5");
+	EXPECT_EQ(ParseNumber<int>(reply.At(4).value()), -3);
+	EXPECT_EQ(reply.At(5), std::nullopt);
+
+	auto lines = Reply::Parse("exp=1\r\ngain=2\r\n>");
+	EXPECT_EQ(lines.Number<uint8_t>("gain", '\n'), 2);
+}
+
+TEST(Reply, ParsesNumbers) {
+	EXPECT_EQ(ParseNumber<int>(" 42 "), 42);
+	EXPECT_EQ(ParseNumber<int>("+42"), 42);
+	EXPECT_EQ(ParseNumber<int>("-42"), -42);
+	EXPECT_EQ(ParseNumber<int>("+-42"), std::nullopt);
+	EXPECT_EQ(ParseNumber<double>("+-4.2"), std::nullopt);
+	EXPECT_EQ(ParseNumber<uint32_t>("-42"), std::nullopt);
+	EXPECT_EQ(ParseNumber<uint8_t>("256"), std::nullopt);
+	EXPECT_EQ(ParseNumber<int>("42ms"), std::nullopt);
+	EXPECT_EQ(ParseNumber<int>(""), std::nullopt);
+	EXPECT_EQ(ParseNumber<double>("1e3"), 1000.0);
+}
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <charconv>
+#include <cstddef>
+#include <iterator>
+#include <optional>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+namespace fort {
+namespace clserpp {
+
+namespace details {
+constexpr bool is_blank(char c) {
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+inline std::string_view trim(std::string_view value) {
+	while (value.empty() == false && is_blank(value.front())) {
+		value.remove_prefix(1);
+	}
+	while (value.empty() == false && is_blank(value.back())) {
+		value.remove_suffix(1);
+	}
+	return value;
+}
+
+// splits "key=value" on its first '=', the key is empty if there is none.
+inline std::pair<std::string_view, std::string_view>
+split_key_value(std::string_view field) {
+	const auto pos = field.find('=');
+	if (pos == std::string_view::npos) {
+		return {{}, trim(field)};
+	}
+	return {trim(field.substr(0, pos)), trim(field.substr(pos + 1))};
+}
+} // namespace details
+
+// Parses a number with std::from_chars(), surrounding blanks are ignored.
+// Returns std::nullopt if value is not entirely a T.
+template <typename T> std::optional<T> ParseNumber(std::string_view value) {
+	static_assert(std::is_arithmetic_v<T>, "T must be a number");
+	value = details::trim(value);
+	if (value.size() > 1 && value.front() == '+') {
+		value.remove_prefix(1);
+		// from_chars() would accept a sign after the stripped one.
+		if (value.front() == '-' || value.front() == '+') {
+			return std::nullopt;
+		}
+	}
+	T          res;
+	const auto end = value.data() + value.size();
+	const auto [ptr, ec] = std::from_chars(value.data(), end, res);
+	if (ec != std::errc{} || ptr != end) {
+		return std::nullopt;
+	}
+	return res;
+}
+
+// Fields of a reply body, separated by sep. Iterating yields trimmed views.
+class Fields {
+public:
+	class iterator {
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type        = std::string_view;
+		using difference_type   = std::ptrdiff_t;
+		using pointer           = const std::string_view *;
+		using reference         = const std::string_view &;
+
+		iterator() = default;
+
+		iterator(std::string_view left, char sep)
+		    : d_left{left}
+		    , d_sep{sep}
+		    , d_end{false} {
+			advance();
+		}
+
+		reference operator*() const {
+			return d_current;
+		}
+
+		pointer operator->() const {
+			return &d_current;
+		}
+
+		iterator &operator++() {
+			advance();
+			return *this;
+		}
+
+		iterator operator++(int) {
+			auto res = *this;
+			advance();
+			return res;
+		}
+
+		bool operator==(const iterator &other) const {
+			return d_end == other.d_end &&
+			       (d_end || d_left.data() == other.d_left.data());
+		}
+
+		bool operator!=(const iterator &other) const {
+			return !(*this == other);
+		}
+
+	private:
+		void advance() {
+			if (d_left.data() == nullptr) {
+				d_end = true;
+				return;
+			}
+			const auto pos = d_left.find(d_sep);
+			d_current      = details::trim(d_left.substr(0, pos));
+			if (pos == std::string_view::npos) {
+				d_left = {};
+			} else {
+				d_left.remove_prefix(pos + 1);
+			}
+		}
+
+		std::string_view d_left, d_current;
+		char             d_sep = ',';
+		bool             d_end = true;
+	};
+
+	Fields(std::string_view value, char sep = ',')
+	    : d_value{value}
+	    , d_sep{sep} {}
+
+	iterator begin() const {
+		if (d_value.empty()) {
+			return end();
+		}
+		return iterator{d_value, d_sep};
+	}
+
+	iterator end() const {
+		return {};
+	}
+
+private:
+	std::string_view d_value;
+	char             d_sep;
+};
+
+// A camera reply, i.e. "exp?\r\nexp=1200\r\n>". Parse() strips the echoed
+// command and the prompt. The Reply is a view on the parsed bytes, and
+// never allocates.
+class Reply {
+public:
+	static Reply Parse(
+	    std::string_view raw,
+	    std::string_view command = {},
+	    std::string_view prompt  = "\r\n>"
+	) {
+		if (prompt.empty() == false && raw.size() >= prompt.size() &&
+		    raw.substr(raw.size() - prompt.size()) == prompt) {
+			raw.remove_suffix(prompt.size());
+		}
+		// the echo is the command, on its own line.
+		command = details::trim(command);
+		if (command.empty() == false && raw.size() > command.size() &&
+		    raw.substr(0, command.size()) == command &&
+		    (raw[command.size()] == '\r' || raw[command.size()] == '\n')) {
+			raw.remove_prefix(command.size());
+		}
+		return Reply{details::trim(raw)};
+	}
+
+	std::string_view Body() const {
+		return d_body;
+	}
+
+	Fields Split(char sep = ',') const {
+		return {d_body, sep};
+	}
+
+	// value of the first key=value field named key.
+	std::optional<std::string_view>
+	Value(std::string_view key, char sep = ',') const {
+		for (const auto field : Split(sep)) {
+			const auto [k, value] = details::split_key_value(field);
+			if (k == key) {
+				return value;
+			}
+		}
+		return std::nullopt;
+	}
+
+	template <typename T>
+	std::optional<T> Number(std::string_view key, char sep = ',') const {
+		const auto value = Value(key, sep);
+		if (value.has_value() == false) {
+			return std::nullopt;
+		}
+		return ParseNumber<T>(value.value());
+	}
+
+	// the field at index, without its key if any.
+	std::optional<std::string_view> At(size_t index, char sep = ',') const {
+		for (const auto field : Split(sep)) {
+			if (index-- == 0) {
+				return details::split_key_value(field).second;
+			}
+		}
+		return std::nullopt;
+	}
+
+private:
+	Reply(std::string_view body)
+	    : d_body{body} {}
+
+	std::string_view d_body;
+};
+
+} // namespace clserpp
+} // namespace fort
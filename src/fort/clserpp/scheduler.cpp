@@ -0,0 +1,190 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "exceptions.hpp"
+#include "scheduler.hpp"
+
+using namespace fort::clserpp;
+
+class MockWriter {
+public:
+	// when holding, Write() blocks until Release() is called.
+	void Hold() {
+		std::lock_guard<std::mutex> lock{d_mutex};
+		d_holding = true;
+	}
+
+	void Release() {
+		{
+			std::lock_guard<std::mutex> lock{d_mutex};
+			d_holding = false;
+		}
+		d_condition.notify_all();
+	}
+
+	// the write number index only accepts accepted bytes.
+	void Stall(size_t index, size_t accepted) {
+		std::lock_guard<std::mutex> lock{d_mutex};
+		d_stallIndex    = index;
+		d_stallAccepted = accepted;
+	}
+
+	void WaitWrites(size_t count) {
+		std::unique_lock<std::mutex> lock{d_mutex};
+		d_condition.wait(lock, [&]() { return d_writes.size() >= count; });
+	}
+
+	template <typename Container>
+	void Write(const Container &buf, uint32_t timeout_ms) {
+		std::unique_lock<std::mutex> lock{d_mutex};
+		d_writes.push_back(std::string(&buf[0], buf.size()));
+		d_condition.notify_all();
+		d_condition.wait(lock, [this]() { return d_holding == false; });
+		if (d_writes.back() == "fail") {
+			throw IOTimeout(0);
+		}
+		if (d_writes.size() == d_stallIndex) {
+			d_writes.back().resize(d_stallAccepted);
+			throw IOTimeout(d_stallAccepted);
+		}
+	}
+
+	std::vector<std::string> Writes() {
+		std::lock_guard<std::mutex> lock{d_mutex};
+		return d_writes;
+	}
+
+private:
+	std::mutex               d_mutex;
+	std::condition_variable  d_condition;
+	bool                     d_holding    = false;
+	size_t                   d_stallIndex = 0, d_stallAccepted = 0;
+	std::vector<std::string> d_writes;
+};
+
+TEST(WriteScheduler, WritesInSubmissionOrder) {
+	auto writer    = std::make_shared<MockWriter>();
+	auto scheduler = WriteScheduler<MockWriter>{writer, CL_BAUDRATE_9600};
+
+	auto a = scheduler.Submit(Buffer{"a"});
+	auto b = scheduler.Submit(Buffer{"b"});
+	auto c = scheduler.Submit(Buffer{"c"});
+	c.get();
+	b.get();
+	a.get();
+
+	EXPECT_EQ(writer->Writes(), std::vector<std::string>({"a", "b", "c"}));
+}
+
+TEST(WriteScheduler, UrgentCommandsPreemptBulkAtChunkBoundary) {
+	auto writer    = std::make_shared<MockWriter>();
+	auto scheduler = WriteScheduler<MockWriter>{
+	    writer,
+	    CL_BAUDRATE_9600,
+	    std::chrono::milliseconds{50},
+	};
+
+	// 50ms at 9600 bauds are 48 bytes.
+	const std::string bulk(120, 'x');
+
+	writer->Hold();
+	auto upload = scheduler.Submit(Buffer{bulk}, Priority::BULK);
+	writer->WaitWrites(1);
+
+	auto normal = scheduler.Submit(Buffer{"normal"});
+	auto urgent = scheduler.Submit(Buffer{"stop"}, Priority::URGENT);
+	EXPECT_EQ(scheduler.Pending(Priority::URGENT), 1);
+	writer->Release();
+
+	upload.get();
+	urgent.get();
+	normal.get();
+
+	const std::string chunk(48, 'x'), last(24, 'x');
+	EXPECT_EQ(
+	    writer->Writes(),
+	    std::vector<std::string>({chunk, "stop", "normal", chunk, last})
+	);
+}
+
+TEST(WriteScheduler, ReportsWriteErrors) {
+	auto writer    = std::make_shared<MockWriter>();
+	auto scheduler = WriteScheduler<MockWriter>{writer, CL_BAUDRATE_9600};
+
+	auto failed = scheduler.Submit(Buffer{"fail"});
+	auto next   = scheduler.Submit(Buffer{"next"});
+
+	EXPECT_THROW({ failed.get(); }, IOTimeout);
+	next.get();
+	EXPECT_EQ(writer->Writes(), std::vector<std::string>({"fail", "next"}));
+}
+
+TEST(WriteScheduler, ReportsBytesWrittenBeforeATimeout) {
+	auto writer    = std::make_shared<MockWriter>();
+	auto scheduler = WriteScheduler<MockWriter>{
+	    writer,
+	    CL_BAUDRATE_115200,
+	    std::chrono::milliseconds{5},
+	};
+
+	// 5ms at 115200 bauds are 57 bytes.
+	writer->Stall(2, 10);
+	auto upload = scheduler.Submit(Buffer{std::string(200, 'x')});
+
+	try {
+		upload.get();
+		ADD_FAILURE() << "should have thrown IOTimeout";
+	} catch (const IOTimeout &e) {
+		EXPECT_EQ(e.bytes(), 67);
+	}
+	EXPECT_EQ(
+	    writer->Writes(),
+	    std::vector<std::string>({std::string(57, 'x'), std::string(10, 'x')})
+	);
+}
+
+TEST(WriteScheduler, PacesChunksAtTheLineRate) {
+	auto writer    = std::make_shared<MockWriter>();
+	auto scheduler = WriteScheduler<MockWriter>{
+	    writer,
+	    CL_BAUDRATE_9600,
+	    std::chrono::milliseconds{20},
+	};
+
+	// 20ms at 9600 bauds are 19 bytes, 96 bytes need 100ms on the wire.
+	const auto start = std::chrono::steady_clock::now();
+	scheduler.Submit(Buffer{std::string(96, 'x')}).get();
+	const auto elapsed = std::chrono::steady_clock::now() - start;
+
+	EXPECT_EQ(writer->Writes().size(), 6);
+	EXPECT_GE(elapsed, std::chrono::milliseconds{80});
+}
+
+TEST(WriteScheduler, AbortsPendingWritesWhenDestroyed) {
+	auto writer = std::make_shared<MockWriter>();
+
+	std::future<void> first, second;
+	std::thread       releaser;
+	writer->Hold();
+	{
+		auto scheduler = WriteScheduler<MockWriter>{writer, CL_BAUDRATE_9600};
+		first          = scheduler.Submit(Buffer{std::string(32, 'x')});
+		second         = scheduler.Submit(Buffer{"second"});
+		writer->WaitWrites(1);
+		// releases the first chunk once the scheduler is stopping.
+		releaser = std::thread{[writer]() {
+			std::this_thread::sleep_for(std::chrono::milliseconds{20});
+			writer->Release();
+		}};
+	}
+	releaser.join();
+	EXPECT_EQ(writer->Writes().size(), 1);
+	EXPECT_THROW({ first.get(); }, cpptrace::runtime_error);
+	EXPECT_THROW({ second.get(); }, cpptrace::runtime_error);
+}
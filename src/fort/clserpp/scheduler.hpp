@@ -0,0 +1,218 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <cpptrace/exceptions.hpp>
+
+#include <spdlog/spdlog.h>
+
+#include "buffer.hpp"
+#include "bulk.hpp"
+#include "clser.h"
+#include "details.hpp"
+#include "exceptions.hpp"
+
+namespace fort {
+namespace clserpp {
+
+enum class Priority {
+	URGENT = 0,
+	NORMAL = 1,
+	BULK   = 2,
+};
+
+// Outbound scheduler for a port. Submitted buffers are written by a single
+// worker thread in chunks of chunkDuration wire time. Between two chunks,
+// the worker always picks the oldest buffer of the most urgent priority,
+// therefore an URGENT command waits at most one chunk of a lower priority
+// transfer. Chunks are paced at the line rate, so a driver buffering writes
+// never queues more than one chunk ahead of the wire. Buffers of the same
+// priority are written in submission order.
+template <typename Port> class WriteScheduler {
+public:
+	WriteScheduler(
+	    std::shared_ptr<Port>     port,
+	    clBaudrate_e              baudrate,
+	    std::chrono::milliseconds chunkDuration = std::chrono::milliseconds{20},
+	    uint32_t                  timeout_ms    = 1000
+	)
+	    : d_port{port}
+	    , d_chunkDuration{chunkDuration}
+	    , d_baudrate{baudrate}
+	    , d_chunkSize{details::chunk_size(baudrate, chunkDuration)}
+	    , d_timeout_ms{timeout_ms} {
+		if (d_port == nullptr) {
+			throw cpptrace::logic_error("cannot function without a Port");
+		}
+		d_worker = std::thread{[this]() { loop(); }};
+	}
+
+	~WriteScheduler() {
+		{
+			std::lock_guard<std::mutex> lock{d_mutex};
+			d_stopping = true;
+		}
+		d_condition.notify_all();
+		d_worker.join();
+	}
+
+	// The returned future is ready once the whole buffer is written, or
+	// holds the exception that aborted its write. An IOTimeout reports the
+	// bytes of the buffer written before it. Pending buffers are aborted
+	// when the scheduler is destroyed.
+	std::future<void>
+	Submit(Buffer data, Priority priority = Priority::NORMAL) {
+		std::future<void> res;
+		{
+			std::lock_guard<std::mutex> lock{d_mutex};
+			if (d_stopping) {
+				throw cpptrace::logic_error("write scheduler is stopped");
+			}
+			auto &job =
+			    d_queues[size_t(priority)].emplace_back(std::move(data));
+			res = job.done.get_future();
+		}
+		d_condition.notify_one();
+		return res;
+	}
+
+	// Adapts the chunk size and pace to a new baudrate. The caller is
+	// responsible to change the port baudrate itself.
+	void SetBaudrate(clBaudrate_e baudrate) {
+		std::lock_guard<std::mutex> lock{d_mutex};
+		d_baudrate  = baudrate;
+		d_chunkSize = details::chunk_size(baudrate, d_chunkDuration);
+	}
+
+	size_t Pending(Priority priority) const {
+		std::lock_guard<std::mutex> lock{d_mutex};
+		return d_queues[size_t(priority)].size();
+	}
+
+private:
+	struct Job {
+		Job(Buffer &&data)
+		    : data{std::move(data)} {}
+
+		Buffer             data;
+		size_t             written = 0;
+		std::promise<void> done;
+	};
+
+	bool idle() const {
+		for (const auto &queue : d_queues) {
+			if (queue.empty() == false) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// returns the next job to write, or nullptr when stopping.
+	Job *next(std::unique_lock<std::mutex> &lock) {
+		while (true) {
+			if (d_stopping) {
+				return nullptr;
+			}
+			for (auto &queue : d_queues) {
+				if (queue.empty() == false) {
+					return &queue.front();
+				}
+			}
+			d_condition.wait(lock);
+		}
+	}
+
+	void done(Job *job) {
+		for (auto &queue : d_queues) {
+			if (queue.empty() == false && &queue.front() == job) {
+				queue.pop_front();
+				return;
+			}
+		}
+	}
+
+	void loop() {
+		std::unique_lock<std::mutex> lock{d_mutex};
+		clBaudrate_e                 baudrate = d_baudrate;
+		details::Pacer               pacer{baudrate};
+		while (true) {
+			// the time spent idle is not a credit for the next chunks.
+			const bool wasIdle = idle();
+			Job       *job     = next(lock);
+			if (job == nullptr) {
+				break;
+			}
+			if (wasIdle || baudrate != d_baudrate) {
+				baudrate = d_baudrate;
+				pacer    = details::Pacer{baudrate};
+			}
+			const size_t chunk =
+			    std::min(d_chunkSize, job->data.size() - job->written);
+			lock.unlock();
+			try {
+				d_port->Write(
+				    details::Span<const char>{
+				        job->data.data() + job->written,
+				        chunk,
+				    },
+				    d_timeout_ms
+				);
+			} catch (const IOTimeout &e) {
+				lock.lock();
+				job->done.set_exception(std::make_exception_ptr(
+				    IOTimeout(job->written + e.bytes())
+				));
+				done(job);
+				pacer.Reset();
+				continue;
+			} catch (...) {
+				lock.lock();
+				job->done.set_exception(std::current_exception());
+				done(job);
+				pacer.Reset();
+				continue;
+			}
+			lock.lock();
+			job->written += chunk;
+			if (job->written == job->data.size()) {
+				job->done.set_value();
+				done(job);
+			}
+			lock.unlock();
+			pacer.Sent(chunk);
+			lock.lock();
+		}
+
+		for (auto &queue : d_queues) {
+			for (auto &job : queue) {
+				job.done.set_exception(std::make_exception_ptr(
+				    cpptrace::runtime_error("write scheduler stopped")
+				));
+			}
+			queue.clear();
+		}
+	}
+
+	std::shared_ptr<Port>     d_port;
+	std::chrono::milliseconds d_chunkDuration;
+	clBaudrate_e              d_baudrate;
+	size_t                    d_chunkSize;
+	uint32_t                  d_timeout_ms;
+
+	mutable std::mutex             d_mutex;
+	std::condition_variable        d_condition;
+	std::array<std::deque<Job>, 3> d_queues;
+	bool                           d_stopping = false;
+	std::thread                    d_worker;
+};
+
+} // namespace clserpp
+} // namespace fort
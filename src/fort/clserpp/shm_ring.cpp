@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+#include "shm_ring.hpp"
+
+using namespace fort::clserpp::details;
+
+TEST(SharedRing, ChecksCapacity) {
+	EXPECT_THROW({ SharedRing::Create(1000); }, cpptrace::logic_error);
+}
+
+TEST(SharedRing, WrapsAround) {
+	auto ring = SharedRing::Create(16);
+
+	char out[16];
+	for (int i = 0; i < 10; ++i) {
+		const std::string data = "abcdefghij" + std::to_string(i);
+		EXPECT_EQ(ring.Write(data.data(), data.size()), data.size());
+		EXPECT_EQ(ring.Available(), data.size());
+		EXPECT_EQ(ring.Read(out, sizeof(out)), data.size());
+		EXPECT_EQ(std::string(out, data.size()), data);
+	}
+	EXPECT_EQ(ring.Dropped(), 0);
+}
+
+TEST(SharedRing, DropsOverflow) {
+	auto ring = SharedRing::Create(16);
+
+	const std::string data(20, 'x');
+	EXPECT_EQ(ring.Write(data.data(), data.size()), 16);
+	EXPECT_EQ(ring.Dropped(), 4);
+	ring.Clear();
+	EXPECT_EQ(ring.Available(), 0);
+}
+
+TEST(SharedRing, IsSharedThroughFileDescriptor) {
+	auto producer = SharedRing::Create(1024);
+	auto consumer = SharedRing::Map(::dup(producer.FileDescriptor()));
+
+	const size_t total = 1 << 16;
+	std::thread  writer{[&producer]() {
+		char   value   = 0;
+		size_t written = 0;
+		while (written < total) {
+			char chunk[100];
+			for (auto &c : chunk) {
+				c = value++;
+			}
+			size_t size = std::min(sizeof(chunk), total - written);
+			size_t done = 0;
+			while (done < size) {
+				done += producer.Write(chunk + done, size - done);
+			}
+			written += size;
+		}
+	}};
+
+	char   expected   = 0;
+	size_t read       = 0;
+	size_t mismatches = 0;
+	while (read < total) {
+		char   chunk[77];
+		size_t size = consumer.Read(chunk, sizeof(chunk));
+		for (size_t i = 0; i < size; ++i) {
+			mismatches += chunk[i] != expected++;
+		}
+		read += size;
+	}
+	writer.join();
+	EXPECT_EQ(mismatches, 0);
+	EXPECT_EQ(consumer.Available(), 0);
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <utility>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cpptrace/exceptions.hpp>
+
+namespace fort {
+namespace clserpp {
+namespace details {
+
+// Single producer, single consumer byte ring living in a shared memory
+// file descriptor, so it can be shared between two processes. The
+// producer never blocks: bytes that do not fit are dropped and accounted
+// in Dropped().
+class SharedRing {
+public:
+	static SharedRing Create(size_t capacity) {
+		if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+			throw cpptrace::logic_error(
+			    "ring capacity " + std::to_string(capacity) +
+			    " is not a power of two"
+			);
+		}
+		int fd = ::memfd_create("clserpp-ring", MFD_CLOEXEC);
+		if (fd < 0) {
+			throw cpptrace::system_error(errno, "could not create ring");
+		}
+		if (::ftruncate(fd, sizeof(Header) + capacity) != 0) {
+			int err = errno;
+			::close(fd);
+			throw cpptrace::system_error(err, "could not size ring");
+		}
+		SharedRing res{fd};
+		new (res.d_header) Header{};
+		res.d_header->capacity = capacity;
+		return res;
+	}
+
+	// takes ownership of fd.
+	static SharedRing Map(int fd) {
+		SharedRing res{fd};
+		if (res.d_size < sizeof(Header) + res.d_header->capacity) {
+			throw cpptrace::runtime_error("invalid shared ring size");
+		}
+		return res;
+	}
+
+	SharedRing(SharedRing &&other) noexcept
+	    : d_fd{std::exchange(other.d_fd, -1)}
+	    , d_size{std::exchange(other.d_size, 0)}
+	    , d_header{std::exchange(other.d_header, nullptr)} {}
+
+	SharedRing &operator=(SharedRing &&other) noexcept {
+		std::swap(d_fd, other.d_fd);
+		std::swap(d_size, other.d_size);
+		std::swap(d_header, other.d_header);
+		return *this;
+	}
+
+	~SharedRing() {
+		if (d_header != nullptr) {
+			::munmap(d_header, d_size);
+		}
+		if (d_fd >= 0) {
+			::close(d_fd);
+		}
+	}
+
+	int FileDescriptor() const {
+		return d_fd;
+	}
+
+	size_t Capacity() const {
+		return d_header->capacity;
+	}
+
+	size_t Available() const {
+		return d_header->head.load(std::memory_order_acquire) -
+		       d_header->tail.load(std::memory_order_acquire);
+	}
+
+	uint64_t Dropped() const {
+		return d_header->dropped.load(std::memory_order_relaxed);
+	}
+
+	// producer side, returns the number of bytes actually written.
+	size_t Write(const char *data, size_t size) {
+		const auto head = d_header->head.load(std::memory_order_relaxed);
+		const auto tail = d_header->tail.load(std::memory_order_acquire);
+		const auto n    = std::min<size_t>(size, Capacity() - (head - tail));
+		copy(head, data, n, [](char *ring, const char *data, size_t size) {
+			std::memcpy(ring, data, size);
+		});
+		d_header->head.store(head + n, std::memory_order_release);
+		if (n < size) {
+			d_header->dropped.fetch_add(size - n, std::memory_order_relaxed);
+		}
+		return n;
+	}
+
+	// consumer side, returns the number of bytes actually read.
+	size_t Read(char *out, size_t size) {
+		const auto tail = d_header->tail.load(std::memory_order_relaxed);
+		const auto head = d_header->head.load(std::memory_order_acquire);
+		const auto n    = std::min<size_t>(size, head - tail);
+		copy(tail, out, n, [](char *ring, char *out, size_t size) {
+			std::memcpy(out, ring, size);
+		});
+		d_header->tail.store(tail + n, std::memory_order_release);
+		return n;
+	}
+
+	// consumer side, drops all available bytes.
+	void Clear() {
+		d_header->tail.store(
+		    d_header->head.load(std::memory_order_acquire),
+		    std::memory_order_release
+		);
+	}
+
+private:
+	struct Header {
+		std::atomic<uint64_t> head{0}, tail{0}, dropped{0};
+		uint64_t              capacity = 0;
+	};
+
+	static_assert(
+	    std::atomic<uint64_t>::is_always_lock_free,
+	    "shared ring needs lock-free 64-bit atomics"
+	);
+
+	SharedRing(int fd)
+	    : d_fd{fd} {
+		struct stat st;
+		if (::fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(Header)) {
+			::close(fd);
+			throw cpptrace::runtime_error("invalid shared ring descriptor");
+		}
+		d_size = st.st_size;
+		void *data =
+		    ::mmap(nullptr, d_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (data == MAP_FAILED) {
+			int err = errno;
+			::close(fd);
+			throw cpptrace::system_error(err, "could not map ring");
+		}
+		d_header = static_cast<Header *>(data);
+	}
+
+	SharedRing(const SharedRing &other)            = delete;
+	SharedRing &operator=(const SharedRing &other) = delete;
+
+	template <typename T, typename Copy>
+	void copy(uint64_t position, T *data, size_t size, Copy &&fn) {
+		char        *ring   = reinterpret_cast<char *>(d_header + 1);
+		const size_t offset = position & (Capacity() - 1);
+		const size_t first  = std::min(size, Capacity() - offset);
+		fn(ring + offset, data, first);
+		fn(ring, data + first, size - first);
+	}
+
+	int     d_fd     = -1;
+	size_t  d_size   = 0;
+	Header *d_header = nullptr;
+};
+
+} // namespace details
+} // namespace clserpp
+} // namespace fort
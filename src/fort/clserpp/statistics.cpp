@@ -0,0 +1,32 @@
+#include <gtest/gtest.h>
+
+#include "statistics.hpp"
+
+using namespace fort::clserpp;
+
+TEST(Statistics, Quantiles) {
+	const std::vector<double> sorted = {1.0, 2.0, 3.0, 4.0};
+	EXPECT_DOUBLE_EQ(Quantile(sorted, 0.0), 1.0);
+	EXPECT_DOUBLE_EQ(Quantile(sorted, 0.5), 2.5);
+	EXPECT_DOUBLE_EQ(Quantile(sorted, 1.0), 4.0);
+	EXPECT_DOUBLE_EQ(Quantile({7.0}, 0.99), 7.0);
+	EXPECT_THROW({ Quantile({}, 0.5); }, cpptrace::logic_error);
+	EXPECT_THROW({ Quantile(sorted, 1.5); }, cpptrace::logic_error);
+}
+
+TEST(Statistics, Summarizes) {
+	std::vector<double> samples;
+	for (int i = 1000; i > 0; --i) {
+		samples.push_back(i);
+	}
+	const auto s = Summarize(samples);
+	EXPECT_EQ(s.count, 1000);
+	EXPECT_DOUBLE_EQ(s.min, 1.0);
+	EXPECT_DOUBLE_EQ(s.max, 1000.0);
+	EXPECT_DOUBLE_EQ(s.mean, 500.5);
+	EXPECT_DOUBLE_EQ(s.median, 500.5);
+	EXPECT_NEAR(s.p99, 990.01, 1e-9);
+	EXPECT_NEAR(s.p999, 999.001, 1e-9);
+
+	EXPECT_EQ(Summarize({}).count, 0);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <numeric>
+#include <vector>
+
+#include <cpptrace/exceptions.hpp>
+
+namespace fort {
+namespace clserpp {
+
+// q-quantile of sorted samples, linearly interpolated between the closest
+// ranks.
+inline double Quantile(const std::vector<double> &sorted, double q) {
+	if (sorted.empty()) {
+		throw cpptrace::logic_error("quantile of no samples");
+	}
+	if (q < 0.0 || q > 1.0) {
+		throw cpptrace::logic_error("quantile out of [0,1]");
+	}
+	const double rank  = q * double(sorted.size() - 1);
+	const size_t lower = size_t(std::floor(rank));
+	const size_t upper = std::min(lower + 1, sorted.size() - 1);
+	return sorted[lower] + (rank - lower) * (sorted[upper] - sorted[lower]);
+}
+
+struct Summary {
+	size_t count = 0;
+	double min = 0.0, mean = 0.0, median = 0.0, p99 = 0.0, p999 = 0.0,
+	       max = 0.0;
+};
+
+// summarizes samples, i.e. round trip durations. All values are zero if
+// there are no samples.
+inline Summary Summarize(std::vector<double> samples) {
+	if (samples.empty()) {
+		return {};
+	}
+	std::sort(samples.begin(), samples.end());
+	return {
+	    .count = samples.size(),
+	    .min   = samples.front(),
+	    .mean  = std::accumulate(samples.begin(), samples.end(), 0.0) /
+	            double(samples.size()),
+	    .median = Quantile(samples, 0.5),
+	    .p99    = Quantile(samples, 0.99),
+	    .p999   = Quantile(samples, 0.999),
+	    .max    = samples.back(),
+	};
+}
+
+} // namespace clserpp
+} // namespace fort
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <string_view>
+
 namespace fort {
 namespace clserpp {
 
@@ -10,5 +12,22 @@ enum class LineTermination {
 	CRLF     = 3,
 	NULLCHAR = 4,
 };
+
+namespace details {
+constexpr std::string_view termination_view(LineTermination termination) {
+	switch (termination) {
+	case LineTermination::LF:
+		return "\n";
+	case LineTermination::CR:
+		return "\r";
+	case LineTermination::CRLF:
+		return "\r\n";
+	case LineTermination::NULLCHAR:
+		return {"\0", 1};
+	default:
+		return "";
+	}
+}
+} // namespace details
 }
 } // namespace fort